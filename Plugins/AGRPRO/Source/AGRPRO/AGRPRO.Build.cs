@@ -28,6 +28,7 @@ public class AGRPRO : ModuleRules
 			{
 				"Core",
 				"GameplayTags",
+				"NetCore",
 				"PhysicsCore",
 				"Niagara",
 				// ... add other public dependencies that you statically link with here ...
@@ -40,10 +41,12 @@ public class AGRPRO : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"AIModule",
 				"Slate",
 				"SlateCore",
 				"InputCore",
 				"UMG",
+				"SignificanceManager",
 				// ... add private dependencies that you statically link with here ...
 			}
 			);
@@ -10,6 +10,8 @@
 #include "Developer/Settings/Public/ISettingsContainer.h"
 // =============================================================================
 
+#include "Data/AGRAnimSettings.h"
+#include "Data/AGRItemSettings.h"
 #include "UI/AGRDebuggerSettings.h"
 
 #define LOCTEXT_NAMESPACE "FAGRPROModule"
@@ -27,6 +29,20 @@ void FAGRPROModule::StartupModule()
 			LOCTEXT("AGRDebuggerDesc", "Configure the AGR Debugger and customize inputs for Debug Widget display and category hide / show"),
 			GetMutableDefault<UAGRDebuggerSettings>()
 		);
+
+		SettingsModule->RegisterSettings(
+			"Project", "Plugins", "AGRItems",
+			LOCTEXT("AGRItemsName", "AGR Items"),
+			LOCTEXT("AGRItemsDesc", "Configure how AGR items lying in the world are indexed and managed"),
+			GetMutableDefault<UAGRItemSettings>()
+		);
+
+		SettingsModule->RegisterSettings(
+			"Project", "Plugins", "AGRAnimation",
+			LOCTEXT("AGRAnimationName", "AGR Animation"),
+			LOCTEXT("AGRAnimationDesc", "Configure significance based level of detail of AGR animation and sound components"),
+			GetMutableDefault<UAGRAnimSettings>()
+		);
 	}
 }
 
@@ -39,6 +55,8 @@ void FAGRPROModule::ShutdownModule()
 	if (ISettingsModule* SettingsModule = FModuleManager::GetModulePtr<ISettingsModule>("Settings"))
 	{
 		SettingsModule->UnregisterSettings("Project", "Plugins", "AGRDebugger");
+		SettingsModule->UnregisterSettings("Project", "Plugins", "AGRItems");
+		SettingsModule->UnregisterSettings("Project", "Plugins", "AGRAnimation");
 	}
 }
 
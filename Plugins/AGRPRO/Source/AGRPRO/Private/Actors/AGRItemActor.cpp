@@ -0,0 +1,10 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#include "Actors/AGRItemActor.h"
+
+AAGRItemActor::AAGRItemActor()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	bReplicates = true;
+}
@@ -5,8 +5,8 @@
 // Sets default values
 AAGRCharacter::AAGRCharacter()
 {
- 	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// AGR work runs in the components, which are scaled by significance. Blueprint children using Event Tick still tick.
+	PrimaryActorTick.bCanEverTick = false;
 
 	InitSkeletalMeshComponent();
 	InitCharacterMovementComponent();
@@ -57,12 +57,6 @@ void AAGRCharacter::InitAGRAnimMasterComponent()
 	AGRAnimMasterComponent = CreateDefaultSubobject<UAGRAnimMasterComponent>("AGRAnimMaster");
 }
 
-// Called every frame
-void AAGRCharacter::Tick(const float DeltaTime)
-{
-	Super::Tick(DeltaTime);
-}
-
 // Called to bind functionality to input
 void AAGRCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 {
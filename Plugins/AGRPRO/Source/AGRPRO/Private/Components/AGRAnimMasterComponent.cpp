@@ -1,12 +1,17 @@
 // Copyright 2021 Adam Grodzki All Rights Reserved.
 
 #include "Components/AGRAnimMasterComponent.h"
+#include "Data/AGRAnimSettings.h"
+#include "Data/AGRComponentTableProvider.h"
+#include "Subsystems/AGR_AnimMasterSubsystem.h"
 
+#include "AIController.h"
+#include "Async/Async.h"
 #include "DrawDebugHelpers.h"
 #include "GameFramework/Character.h"
-#include "Kismet/GameplayStatics.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Net/UnrealNetwork.h"
+#include "TimerManager.h"
 
 #if WITH_EDITOR
 #include "UI/AGRDebuggerController.h"
@@ -49,6 +54,21 @@ void UAGRAnimMasterComponent::GetLifetimeReplicatedProps(TArray<FLifetimePropert
 	DOREPLIFETIME(UAGRAnimMasterComponent, AimOffsetType);
 	DOREPLIFETIME(UAGRAnimMasterComponent, AimOffsetBehavior);
 	DOREPLIFETIME(UAGRAnimMasterComponent, AnimModTags);
+	DOREPLIFETIME_CONDITION(UAGRAnimMasterComponent, NetAimState, COND_SimulatedOnly);
+}
+
+void UAGRAnimMasterComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	FAGRComponentTable::Update(this, &FAGRComponentTable::AnimationMaster, true);
+}
+
+void UAGRAnimMasterComponent::OnUnregister()
+{
+	FAGRComponentTable::Update(this, &FAGRComponentTable::AnimationMaster, false);
+
+	Super::OnUnregister();
 }
 
 void UAGRAnimMasterComponent::BeginPlay()
@@ -56,6 +76,7 @@ void UAGRAnimMasterComponent::BeginPlay()
 	Super::BeginPlay();
 
 	RecastOwner();
+	AimTraceDelegate.BindUObject(this, &UAGRAnimMasterComponent::OnAsyncAimTraceDone);
 	SetupBasePose(BasePose);
 	SetupOverlayPose(OverlayPose);
 	SetupFpp(bFirstPerson);
@@ -65,6 +86,35 @@ void UAGRAnimMasterComponent::BeginPlay()
 	#if WITH_EDITOR
 	SetupGameplayDebug();
 	#endif
+
+	if(UAGR_AnimMasterSubsystem* AnimMasterSubsystem = UAGR_AnimMasterSubsystem::Get(this))
+	{
+		// The subsystem only runs the native tick, Blueprint subclasses with an Event Tick keep their own tick function
+		const bool bBlueprintTick = GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(UAGRAnimMasterComponent, ReceiveTick));
+		if(GetDefault<UAGRAnimSettings>()->bManageAnimMasterTicks && !bBlueprintTick && PrimaryComponentTick.IsTickFunctionEnabled())
+		{
+			AnimMasterSubsystem->RegisterManagedTick(this);
+
+			// Own tick function off for good, SetComponentTickEnabled now only changes the managed state
+			Super::SetComponentTickEnabled(false);
+		}
+
+		AnimMasterSubsystem->RegisterSignificance(GetOwner());
+	}
+}
+
+void UAGRAnimMasterComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if(UAGR_AnimMasterSubsystem* AnimMasterSubsystem = UAGR_AnimMasterSubsystem::Get(this))
+	{
+		AnimMasterSubsystem->UnregisterSignificance(GetOwner());
+		AnimMasterSubsystem->UnregisterManagedTick(this);
+	}
+
+	PendingAimTrace = FTraceHandle();
+	AimTraceDelegate.Unbind();
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void UAGRAnimMasterComponent::TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -76,20 +126,52 @@ void UAGRAnimMasterComponent::TickComponent(const float DeltaTime, const ELevelT
 		return;
 	}
 
-	AimTick();
+	SignificantAimTick();
 	TurnInPlaceTick();
 }
 
+void UAGRAnimMasterComponent::SetComponentTickEnabled(bool bEnabled)
+{
+	if(ManagedTickIndex != INDEX_NONE)
+	{
+		if(UAGR_AnimMasterSubsystem* AnimMasterSubsystem = UAGR_AnimMasterSubsystem::Get(this))
+		{
+			AnimMasterSubsystem->SetManagedTickState(this, bEnabled);
+		}
+		return;
+	}
+
+	Super::SetComponentTickEnabled(bEnabled);
+}
+
+void UAGRAnimMasterComponent::SetComponentTickEnabledAsync(bool bEnabled)
+{
+	if(ManagedTickIndex != INDEX_NONE)
+	{
+		// The managed state is game thread only, apply it when the engine would apply the async change
+		AsyncTask(ENamedThreads::GameThread, [WeakThis = TWeakObjectPtr<UAGRAnimMasterComponent>(this), bEnabled]()
+		{
+			if(UAGRAnimMasterComponent* Component = WeakThis.Get())
+			{
+				Component->SetComponentTickEnabled(bEnabled);
+			}
+		});
+		return;
+	}
+
+	Super::SetComponentTickEnabledAsync(bEnabled);
+}
+
 void UAGRAnimMasterComponent::SetupBasePose(FGameplayTag InBasePose)
 {
 	BasePose = InBasePose;
-	ServerSetBasePose(InBasePose);
+	RequestSetupSync();
 }
 
 void UAGRAnimMasterComponent::SetupOverlayPose(FGameplayTag InOverlayPose)
 {
 	OverlayPose = InOverlayPose;
-	ServerSetOverlayPose(InOverlayPose);
+	RequestSetupSync();
 }
 
 void UAGRAnimMasterComponent::SetupFpp(bool bInFirstPerson)
@@ -111,7 +193,7 @@ void UAGRAnimMasterComponent::SetupRotation(
 	TurnStartAngle = InTurnStartAngle;
 	TurnStopTolerance = InTurnStopTolerance;
 
-	ServerSetRotation(InRotationMethod, InRotationSpeed, InTurnStartAngle, InTurnStopTolerance);
+	RequestSetupSync();
 }
 
 void UAGRAnimMasterComponent::SetupAimOffset(
@@ -129,7 +211,7 @@ void UAGRAnimMasterComponent::SetupAimOffset(
 	AimSocketName = InAimSocketName;
 	LookAtSocketName = InLookAtSocketName;
 
-	ServerSetupAimOffset(InAimOffsetType, InAimBehavior);
+	RequestSetupSync();
 }
 
 void UAGRAnimMasterComponent::AddTag(FGameplayTag InTag)
@@ -153,9 +235,17 @@ void UAGRAnimMasterComponent::AimTick()
 		else
 		{
 			AimOffset = OwningCharacter->GetControlRotation();
-			ServerSetAimOffset(AimOffset);
-			LookAtWithoutCamera();
+			if(AILookAtMode != EAGRAILookAtMode::Focus || !LookAtAIFocus())
+			{
+				LookAtWithoutCamera();
+			}
 		}
+
+		UpdateNetAimState();
+	}
+	else if(bInterpolateRemoteAim && GetOwnerRole() == ROLE_SimulatedProxy)
+	{
+		SampleRemoteAim();
 	}
 }
 
@@ -184,6 +274,32 @@ void UAGRAnimMasterComponent::TurnInPlaceTick()
 	}
 }
 
+void UAGRAnimMasterComponent::ApplySignificanceBucket(const FAGRSignificanceBucket* Bucket)
+{
+	// Only gates the aim work. The tick itself keeps running for turn in place, which drives gameplay rotation.
+	bAimSignificant = Bucket != nullptr && Bucket->bAim;
+	SignificanceAimInterval = bAimSignificant ? Bucket->AimTickInterval : 0.0f;
+}
+
+void UAGRAnimMasterComponent::SignificantAimTick()
+{
+	const float WorldTime = GetWorld()->GetTimeSeconds();
+	if(bAimSignificant && WorldTime - LastAimTickTime >= SignificanceAimInterval)
+	{
+		LastAimTickTime = WorldTime;
+		AimTick();
+		return;
+	}
+
+	// Skipped aim: locally controlled characters without a camera still turn towards the control rotation and keep
+	// their replicated aim up to date, both without any trace
+	if(IsValid(OwningCharacter) && OwningCharacter->IsLocallyControlled() && !(OwningCharacter->IsPlayerControlled() && CameraBased))
+	{
+		AimOffset = OwningCharacter->GetControlRotation();
+		UpdateNetAimState();
+	}
+}
+
 void UAGRAnimMasterComponent::RecastOwner()
 {
 	// If the owner is invalid, return.
@@ -192,6 +308,7 @@ void UAGRAnimMasterComponent::RecastOwner()
 		return;
 	}
 	OwningCharacter = Cast<ACharacter>(GetOwner());
+	TraceContext.Initialize(GetOwner(), SCENE_QUERY_STAT_NAME_ONLY(AGRAimTrace));
 
 
 	// If the owning character is invalid, return.
@@ -254,193 +371,463 @@ void UAGRAnimMasterComponent::HandleRotationMethodChange()
 
 void UAGRAnimMasterComponent::LookAtIfPlayerControlled()
 {
-	APlayerCameraManager* PlayerCam = UGameplayStatics::GetPlayerCameraManager(this, 0);
+	APlayerCameraManager* PlayerCam = TraceContext.GetCameraManager();
 
 	if (!IsValid(PlayerCam))
 	{
 		return;
 	}
 
-	FHitResult HitResult;
+	const FVector Start = PlayerCam->GetCameraLocation();
+	const FVector End = Start + (PlayerCam->GetCameraRotation().Vector() * 10000.0f);
 
-	FVector Start = PlayerCam->GetCameraLocation();
-	FVector End = Start + (PlayerCam->GetCameraRotation().Vector() * 10000.0f);
+	TraceAim(Start, End, true);
+}
 
-	FCollisionQueryParams QueryParams;
+void UAGRAnimMasterComponent::LookAtWithoutCamera()
+{
+	float offsetStart = 10000.0f;
+
+	FName Socket = LookAtSocketName;
+	const FVector Start = OwningCharacter->GetMesh()->GetSocketLocation(Socket);
+	const FVector End = (UKismetMathLibrary::GetForwardVector(OwningCharacter->GetController()->GetControlRotation()) * offsetStart) + Start;
+
+	TraceAim(Start, End, false);
+}
+
+bool UAGRAnimMasterComponent::LookAtAIFocus()
+{
+	const AAIController* AIController = Cast<AAIController>(OwningCharacter->GetController());
+	if(!IsValid(AIController))
+	{
+		return false;
+	}
+
+	// Focus actor or location, whichever has the highest priority
+	const FVector FocalPoint = AIController->GetFocalPoint();
+	if(FAISystem::IsValidLocation(FocalPoint))
+	{
+		ApplyAimTarget(FocalPoint, true);
+	}
+	else
+	{
+		// No focus: look straight ahead, like a trace hitting nothing
+		const FVector Start = OwningCharacter->GetMesh()->GetSocketLocation(LookAtSocketName);
+		ApplyAimTarget(Start + AimOffset.Vector() * 10000.0f, false);
+	}
+
+	return true;
+}
 
-	TArray<AActor*> IgnoredActors;
-	OwningCharacter->GetAttachedActors(IgnoredActors, true);
-	QueryParams.AddIgnoredActors(IgnoredActors);
-	QueryParams.AddIgnoredActor(GetOwner());
+void UAGRAnimMasterComponent::TraceAim(const FVector& Start, const FVector& End, const bool bUpdateAimOffset)
+{
+	if(CanReuseAimTrace(Start, (End - Start).GetSafeNormal(), bUpdateAimOffset))
+	{
+		// Still re-aim from the current socket location, only the trace itself is skipped
+		ApplyAimTraceResult(AimTraceCache.HitResult, AimTraceCache.bHit, bUpdateAimOffset);
+		return;
+	}
 
+	FCollisionQueryParams& QueryParams = TraceContext.GetQueryParams();
 	QueryParams.bTraceComplex = true;
 	#if WITH_EDITOR
 	QueryParams.bDebugQuery = bDebug;
 	#endif
 
-	const FName Socket = AimOffsetType == EAimOffsets::Aim ? AimSocketName : LookAtSocketName;
-
-	const bool bHit = GetWorld()->LineTraceSingleByChannel(HitResult, Start, End, TraceChannel, QueryParams);
-	if(bHit)
+	if(AimTraceMode == EAGRAimTraceMode::Batched)
 	{
-		LookAtLocation = HitResult.ImpactPoint;
-		ServerSetLookAt(LookAtLocation);
-		AimOffset = UKismetMathLibrary::FindLookAtRotation(OwningCharacter->GetMesh()->GetSocketLocation(Socket), HitResult.ImpactPoint);
-		ServerSetAimOffset(AimOffset);
-
-		#if WITH_EDITOR
-		if(bDebug)
+		if(UAGR_AnimMasterSubsystem* AnimMasterSubsystem = UAGR_AnimMasterSubsystem::Get(this))
 		{
-			Start =  OwningCharacter->GetMesh()->GetSocketLocation(LookAtSocketName);
-			End = HitResult.ImpactPoint;
-			DrawDebugLine(GetWorld(), Start, End, LookAtLineColor, bLinePersists, LineLifetime, 0, LineThickness);
-
-			Start =  OwningCharacter->GetMesh()->GetSocketLocation(AimSocketName);
-			DrawDebugLine(GetWorld(), Start, End, AimLineColor,bLinePersists, LineLifetime, 0, LineThickness);
+			AnimMasterSubsystem->RequestAimTrace(this, Start, End, TraceChannel, QueryParams, bUpdateAimOffset);
+			return;
 		}
-		#endif
 	}
-	else
+	else if(AimTraceMode == EAGRAimTraceMode::Async)
 	{
-		LookAtLocation = HitResult.TraceEnd;
-		ServerSetLookAt(LookAtLocation);
-		AimOffset = UKismetMathLibrary::FindLookAtRotation(OwningCharacter->GetMesh()->GetSocketLocation(Socket), HitResult.TraceEnd);
-		ServerSetAimOffset(AimOffset);
+		// Applied through the delegate when the trace finished, independent of the tick interval. Until then the
+		// previous result stays in place.
+		PendingAimTrace = GetWorld()->AsyncLineTraceByChannel(EAsyncTraceType::Single, Start, End, TraceChannel, QueryParams,
+			FCollisionResponseParams::DefaultResponseParam, &AimTraceDelegate);
+		bPendingAimTraceUpdatesAimOffset = bUpdateAimOffset;
+		return;
+	}
 
-		#if WITH_EDITOR
-		if(bDebug)
-		{
-			Start =  OwningCharacter->GetMesh()->GetSocketLocation(LookAtSocketName);
-			End = HitResult.TraceEnd;
-			DrawDebugLine(GetWorld(), Start, End, LookAtLineColor, bLinePersists, LineLifetime, 0, LineThickness);
+	FHitResult HitResult;
+	const bool bHit = GetWorld()->LineTraceSingleByChannel(HitResult, Start, End, TraceChannel, QueryParams);
+	StoreAimTrace(Start, End, HitResult, bHit, bUpdateAimOffset);
+	ApplyAimTraceResult(HitResult, bHit, bUpdateAimOffset);
+}
 
-			Start =  OwningCharacter->GetMesh()->GetSocketLocation(AimSocketName);
-			DrawDebugLine(GetWorld(), Start, End, AimLineColor, bLinePersists, LineLifetime, 0, LineThickness);
-		}
-		#endif
+void UAGRAnimMasterComponent::OnAsyncAimTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum)
+{
+	// Superseded by a newer trace or the component stopped playing
+	if(TraceHandle != PendingAimTrace || !IsValid(OwningCharacter))
+	{
+		return;
 	}
+	PendingAimTrace = FTraceHandle();
+
+	const bool bHit = TraceDatum.OutHits.Num() > 0 && TraceDatum.OutHits[0].bBlockingHit;
+	FHitResult HitResult;
+	if(bHit)
+	{
+		HitResult = TraceDatum.OutHits[0];
+	}
+	else
+	{
+		// Same as a missed synchronous trace: only the trace end is filled
+		HitResult.TraceStart = TraceDatum.Start;
+		HitResult.TraceEnd = TraceDatum.End;
+	}
+
+	StoreAimTrace(TraceDatum.Start, TraceDatum.End, HitResult, bHit, bPendingAimTraceUpdatesAimOffset);
+	ApplyAimTraceResult(HitResult, bHit, bPendingAimTraceUpdatesAimOffset);
 }
 
-void UAGRAnimMasterComponent::LookAtWithoutCamera()
+void UAGRAnimMasterComponent::ApplyBatchedAimTrace(const FAGRAimTraceRequest& Request)
 {
-	FHitResult HitResult;
-	float offsetStart = 10000.0f;
+	if(!IsValid(OwningCharacter))
+	{
+		return;
+	}
 
-	FCollisionQueryParams QueryParams;
-	#if WITH_EDITOR
-	QueryParams.bDebugQuery = bDebug;
-	#endif
-	QueryParams.bTraceComplex = true;
+	StoreAimTrace(Request.Start, Request.End, Request.HitResult, Request.bHit, Request.bUpdateAimOffset);
+	ApplyAimTraceResult(Request.HitResult, Request.bHit, Request.bUpdateAimOffset);
+}
 
-	TArray<AActor*> IgnoredActors;
-	OwningCharacter->GetAttachedActors(IgnoredActors, true);
-	QueryParams.AddIgnoredActors(IgnoredActors);
-	QueryParams.AddIgnoredActor(GetOwner());
+bool UAGRAnimMasterComponent::CanReuseAimTrace(const FVector& Start, const FVector& Direction, const bool bUpdateAimOffset)
+{
+	if(!bCacheAimTrace || !AimTraceCache.bValid || AimTraceCache.bUpdateAimOffset != bUpdateAimOffset)
+	{
+		return false;
+	}
 
-	FName Socket = LookAtSocketName;
-	FVector Start = OwningCharacter->GetMesh()->GetSocketLocation(Socket);
-	FVector End = (UKismetMathLibrary::GetForwardVector(OwningCharacter->GetController()->GetControlRotation()) * offsetStart) + Start;
+	if(GetWorld()->GetTimeSeconds() - AimTraceCache.Time > AimTraceMaxCacheAge)
+	{
+		return false;
+	}
 
-	const bool bHit = GetWorld()->LineTraceSingleByChannel(HitResult, Start, End, TraceChannel, QueryParams);
-	if (bHit)
+	if(FVector::DistSquared(Start, AimTraceCache.Start) > FMath::Square(AimTraceCacheDistance)
+		|| (Direction | AimTraceCache.Direction) < FMath::Cos(FMath::DegreesToRadians(AimTraceCacheAngle)))
 	{
-		LookAtLocation = HitResult.ImpactPoint;
-		ServerSetLookAt(LookAtLocation);
+		return false;
+	}
 
-		#if WITH_EDITOR
-		if (bDebug)
+	// A moving target invalidates the hit
+	const UPrimitiveComponent* HitComponent = AimTraceCache.bHit ? AimTraceCache.HitResult.GetComponent() : nullptr;
+	if(AimTraceCache.bHit)
+	{
+		if(!IsValid(HitComponent) || !HitComponent->GetComponentTransform().Equals(AimTraceCache.HitComponentTransform, 0.1f))
 		{
-			Start = OwningCharacter->GetMesh()->GetSocketLocation(LookAtSocketName);
-			End = HitResult.ImpactPoint;
-			DrawDebugLine(GetWorld(), Start, End, LookAtLineColor, bLinePersists, LineLifetime, 0, LineThickness);
-
-			Start = OwningCharacter->GetMesh()->GetSocketLocation(AimSocketName);
-			DrawDebugLine(GetWorld(), Start, End, AimLineColor, bLinePersists, LineLifetime, 0, LineThickness);
+			return false;
 		}
-		#endif
 	}
-	else
+
+	// Anything dynamic that moved into the ray since: a thin box along the traced segment against simple collision
+	FCollisionQueryParams QueryParams = TraceContext.GetQueryParams();
+	QueryParams.bTraceComplex = false;
+	if(IsValid(HitComponent))
 	{
-		LookAtLocation = HitResult.TraceEnd;
-		ServerSetLookAt(LookAtLocation);
+		QueryParams.AddIgnoredComponent(HitComponent);
+	}
 
-		#if WITH_EDITOR
-		if (bDebug)
-		{
-			Start = OwningCharacter->GetMesh()->GetSocketLocation(LookAtSocketName);
-			End = HitResult.TraceEnd;
-			DrawDebugLine(GetWorld(), Start, End, LookAtLineColor, bLinePersists, LineLifetime, 0, LineThickness);
+	FCollisionObjectQueryParams ObjectQueryParams;
+	ObjectQueryParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+	ObjectQueryParams.AddObjectTypesToQuery(ECC_Pawn);
+	ObjectQueryParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+
+	const FVector Ray = AimTraceCache.End - AimTraceCache.Start;
+	const FCollisionShape RayBox = FCollisionShape::MakeBox(FVector(Ray.Size() * 0.5f, 2.0f, 2.0f));
+	return !GetWorld()->OverlapAnyTestByObjectType(
+		AimTraceCache.Start + Ray * 0.5f,
+		AimTraceCache.Direction.ToOrientationQuat(),
+		ObjectQueryParams,
+		RayBox,
+		QueryParams);
+}
 
-			Start = OwningCharacter->GetMesh()->GetSocketLocation(AimSocketName);
-			DrawDebugLine(GetWorld(), Start, End, AimLineColor, bLinePersists, LineLifetime, 0, LineThickness);
-		}
-		#endif
+void UAGRAnimMasterComponent::StoreAimTrace(
+	const FVector& Start,
+	const FVector& End,
+	const FHitResult& HitResult,
+	const bool bHit,
+	const bool bUpdateAimOffset)
+{
+	const UPrimitiveComponent* HitComponent = HitResult.GetComponent();
+
+	AimTraceCache.bValid = true;
+	AimTraceCache.bHit = bHit;
+	AimTraceCache.bUpdateAimOffset = bUpdateAimOffset;
+	AimTraceCache.Time = GetWorld()->GetTimeSeconds();
+	AimTraceCache.Start = Start;
+	AimTraceCache.Direction = (End - Start).GetSafeNormal();
+	AimTraceCache.End = bHit ? FVector(HitResult.ImpactPoint) : End;
+	AimTraceCache.HitResult = HitResult;
+	AimTraceCache.HitComponentTransform = IsValid(HitComponent) ? HitComponent->GetComponentTransform() : FTransform::Identity;
+}
+
+void UAGRAnimMasterComponent::ApplyAimTraceResult(const FHitResult& HitResult, const bool bHit, const bool bUpdateAimOffset)
+{
+	ApplyAimTarget(bHit ? FVector(HitResult.ImpactPoint) : FVector(HitResult.TraceEnd), bUpdateAimOffset);
+}
+
+void UAGRAnimMasterComponent::ApplyAimTarget(const FVector& Target, const bool bUpdateAimOffset)
+{
+	LookAtLocation = Target;
+	if(bUpdateAimOffset)
+	{
+		const FName Socket = AimOffsetType == EAimOffsets::Aim ? AimSocketName : LookAtSocketName;
+		AimOffset = UKismetMathLibrary::FindLookAtRotation(OwningCharacter->GetMesh()->GetSocketLocation(Socket), Target);
+	}
+
+	#if WITH_EDITOR
+	if(bDebug)
+	{
+		FVector Start = OwningCharacter->GetMesh()->GetSocketLocation(LookAtSocketName);
+		DrawDebugLine(GetWorld(), Start, Target, LookAtLineColor, bLinePersists, LineLifetime, 0, LineThickness);
+
+		Start = OwningCharacter->GetMesh()->GetSocketLocation(AimSocketName);
+		DrawDebugLine(GetWorld(), Start, Target, AimLineColor, bLinePersists, LineLifetime, 0, LineThickness);
 	}
+	#endif
+}
+
+void UAGRAnimMasterComponent::OnRep_SetupState()
+{
+	bSetupStateSent = false;
 }
 
 void UAGRAnimMasterComponent::OnRep_RotationMethod()
 {
+	bSetupStateSent = false;
 	HandleRotationMethodChange();
 }
 
 void UAGRAnimMasterComponent::OnRep_RotationSpeed()
 {
+	bSetupStateSent = false;
 	HandleRotationSpeedChange();
 }
 
-void UAGRAnimMasterComponent::ServerSetAimOffset_Implementation(const FRotator InAimOffset)
+void UAGRAnimMasterComponent::UpdateNetAimState()
+{
+	const float WorldTime = GetWorld()->GetTimeSeconds();
+	if(bAimStateSent && AimNetUpdateRate > 0.0f && WorldTime - LastAimSendTime < 1.0f / AimNetUpdateRate)
+	{
+		return;
+	}
+
+	FAGRNetAimState NewState;
+	NewState.Set(AimOffset, LookAtLocation);
+
+	bool bChanged = !bAimStateSent;
+	if(bAimStateSent && !(NewState == LastSentAimState))
+	{
+		const FRotator AimDelta = (NewState.GetAimOffset() - LastSentAimState.GetAimOffset()).GetNormalized();
+		const bool bAimChanged = FMath::Abs(AimDelta.Pitch) > AimNetAngleThreshold || FMath::Abs(AimDelta.Yaw) > AimNetAngleThreshold;
+		const bool bLookAtChanged = FVector::DistSquared(NewState.LookAtLocation, LastSentAimState.LookAtLocation) > FMath::Square(LookAtNetDistanceThreshold);
+		bChanged = bAimChanged || bLookAtChanged;
+	}
+
+	if(bChanged)
+	{
+		bAimRestStateSent = false;
+	}
+	else
+	{
+		// Updates are unreliable: once the aim rests, send where it came to rest one more time
+		if(bAimRestStateSent || AimNetRestResendDelay <= 0.0f || WorldTime - LastAimSendTime < AimNetRestResendDelay)
+		{
+			return;
+		}
+
+		bAimRestStateSent = true;
+	}
+
+	LastSentAimState = NewState;
+	LastAimSendTime = WorldTime;
+	bAimStateSent = true;
+
+	// Listen server players and AI write the replicated state directly
+	if(GetOwnerRole() == ROLE_Authority)
+	{
+		NetAimState = NewState;
+	}
+	else
+	{
+		ServerSetAimState(NewState);
+	}
+}
+
+void UAGRAnimMasterComponent::OnRep_NetAimState()
 {
-	NetMutiSetAimOffset(InAimOffset);
+	if(bInterpolateRemoteAim)
+	{
+		PushAimSample(NetAimState.GetAimOffset(), NetAimState.LookAtLocation);
+	}
+	else
+	{
+		AimOffset = NetAimState.GetAimOffset();
+		LookAtLocation = NetAimState.LookAtLocation;
+	}
 }
 
-void UAGRAnimMasterComponent::NetMutiSetAimOffset_Implementation(const FRotator InAimOffset)
+void UAGRAnimMasterComponent::PushAimSample(const FRotator& InAimOffset, const FVector& InLookAtLocation)
 {
-	if(OwningCharacter && !OwningCharacter->IsLocallyControlled())
+	const float WorldTime = GetWorld()->GetTimeSeconds();
+
+	// After a pause the controlling client sends nothing until the aim moves again. Restart the interpolation from
+	// the resting aim instead of sweeping across the whole pause.
+	if(AimSampleCount > 0 && WorldTime - GetAimSample(0).Time > RemoteAimInterpDelay + RemoteAimMaxExtrapolation * 2.0f)
 	{
-		AimOffset = InAimOffset;
+		FAimSample Rest = GetAimSample(0);
+		Rest.Time = WorldTime - RemoteAimInterpDelay;
+		AimSampleCount = 0;
+
+		AimSamples[AimSampleHead] = Rest;
+		AimSampleHead = (AimSampleHead + 1) % AimSampleCapacity;
+		AimSampleCount++;
 	}
+
+	FAimSample& Sample = AimSamples[AimSampleHead];
+	Sample.Time = WorldTime;
+	Sample.AimOffset = InAimOffset;
+	Sample.LookAtLocation = InLookAtLocation;
+
+	AimSampleHead = (AimSampleHead + 1) % AimSampleCapacity;
+	AimSampleCount = FMath::Min(AimSampleCount + 1, AimSampleCapacity);
 }
 
-void UAGRAnimMasterComponent::ServerSetupAimOffset_Implementation(const EAimOffsets InAimOffsetType, const EAimOffsetClamp InAimBehavior)
+void UAGRAnimMasterComponent::SampleRemoteAim()
 {
-	AimOffsetType = InAimOffsetType;
-	AimOffsetBehavior = InAimBehavior;
+	if(AimSampleCount == 0)
+	{
+		return;
+	}
+
+	const float RenderTime = GetWorld()->GetTimeSeconds() - RemoteAimInterpDelay;
+	const FAimSample& Newest = GetAimSample(0);
+
+	if(RenderTime >= Newest.Time)
+	{
+		AimOffset = Newest.AimOffset;
+		LookAtLocation = Newest.LookAtLocation;
+
+		// Keep the last motion going for a short gap, then ease back onto the last received aim
+		const FAimSample* Previous = AimSampleCount > 1 ? &GetAimSample(1) : nullptr;
+		const float SampleDelta = Previous ? Newest.Time - Previous->Time : 0.0f;
+		if(Previous && SampleDelta > KINDA_SMALL_NUMBER && RemoteAimMaxExtrapolation > 0.0f)
+		{
+			const float Overshoot = RenderTime - Newest.Time;
+			const float ExtrapolationTime = Overshoot <= RemoteAimMaxExtrapolation
+				? Overshoot
+				: FMath::Max(0.0f, RemoteAimMaxExtrapolation * 2.0f - Overshoot);
+			const float Alpha = ExtrapolationTime / SampleDelta;
+
+			AimOffset += (Newest.AimOffset - Previous->AimOffset).GetNormalized() * Alpha;
+			AimOffset.Normalize();
+			LookAtLocation += (Newest.LookAtLocation - Previous->LookAtLocation) * Alpha;
+		}
+		return;
+	}
+
+	// Newest to oldest: find the two samples around the render time
+	for(int32 Age = 1; Age < AimSampleCount; Age++)
+	{
+		const FAimSample& From = GetAimSample(Age);
+		if(From.Time <= RenderTime)
+		{
+			const FAimSample& To = GetAimSample(Age - 1);
+			const float Alpha = (RenderTime - From.Time) / FMath::Max(To.Time - From.Time, KINDA_SMALL_NUMBER);
+
+			AimOffset = FMath::Lerp(From.AimOffset, To.AimOffset, Alpha);
+			LookAtLocation = FMath::Lerp(From.LookAtLocation, To.LookAtLocation, Alpha);
+			return;
+		}
+	}
+
+	// Render time is older than the buffer
+	const FAimSample& Oldest = GetAimSample(AimSampleCount - 1);
+	AimOffset = Oldest.AimOffset;
+	LookAtLocation = Oldest.LookAtLocation;
 }
 
-void UAGRAnimMasterComponent::ServerSetRotation_Implementation(
-	const ERotationMethod InRotationMethod,
-	const float InRotationSpeed,
-	const float InTurnStartAngle,
-	const float InTurnStopTolerance)
+void UAGRAnimMasterComponent::ServerSetAimState_Implementation(const FAGRNetAimState& InAimState)
 {
-	RotationMethod = InRotationMethod;
-	HandleRotationMethodChange();
-	RotationSpeed = InRotationSpeed;
-	HandleRotationSpeedChange();
-	TurnStartAngle = InTurnStartAngle;
-	TurnStopTolerance = InTurnStopTolerance;
+	NetAimState = InAimState;
+
+	// The server animates remote players with the received state as well. No buffering, server side logic should
+	// see the latest aim.
+	AimOffset = InAimState.GetAimOffset();
+	LookAtLocation = InAimState.LookAtLocation;
 }
 
-void UAGRAnimMasterComponent::ServerSetOverlayPose_Implementation(const FGameplayTag InOverlayPose)
+void UAGRAnimMasterComponent::RequestSetupSync()
 {
-	OverlayPose = InOverlayPose;
+	// The server replicates its own values, only the owning client has to send
+	if(bSetupSyncPending || GetOwnerRole() == ROLE_Authority || !IsValid(GetWorld()))
+	{
+		return;
+	}
+
+	bSetupSyncPending = true;
+	GetWorld()->GetTimerManager().SetTimerForNextTick(this, &UAGRAnimMasterComponent::FlushSetupSync);
 }
 
-void UAGRAnimMasterComponent::ServerSetBasePose_Implementation(const FGameplayTag InBasePose)
+void UAGRAnimMasterComponent::FlushSetupSync()
 {
-	BasePose = InBasePose;
+	bSetupSyncPending = false;
+
+	// Simulated proxies have no connection to send on
+	if(GetOwnerRole() != ROLE_AutonomousProxy)
+	{
+		return;
+	}
+
+	const FAGRAnimSetupState SetupState = GetSetupState();
+	if(bSetupStateSent && SetupState == SentSetupState)
+	{
+		return;
+	}
+
+	SentSetupState = SetupState;
+	bSetupStateSent = true;
+	ServerSetSetupState(SetupState);
 }
 
-void UAGRAnimMasterComponent::ServerSetLookAt_Implementation(const FVector LookAt)
+FAGRAnimSetupState UAGRAnimMasterComponent::GetSetupState() const
 {
-	NetMutiSetLookAt(LookAt);
+	FAGRAnimSetupState SetupState;
+	SetupState.BasePose = BasePose;
+	SetupState.OverlayPose = OverlayPose;
+	SetupState.RotationMethod = RotationMethod;
+	SetupState.RotationSpeed = RotationSpeed;
+	SetupState.TurnStartAngle = TurnStartAngle;
+	SetupState.TurnStopTolerance = TurnStopTolerance;
+	SetupState.AimOffsetType = AimOffsetType;
+	SetupState.AimOffsetBehavior = AimOffsetBehavior;
+	return SetupState;
 }
 
-void UAGRAnimMasterComponent::NetMutiSetLookAt_Implementation(const FVector LookAt)
+void UAGRAnimMasterComponent::ServerSetSetupState_Implementation(const FAGRAnimSetupState& InSetupState)
 {
-	if (OwningCharacter && !OwningCharacter->IsLocallyControlled())
+	BasePose = InSetupState.BasePose;
+	OverlayPose = InSetupState.OverlayPose;
+	AimOffsetType = InSetupState.AimOffsetType;
+	AimOffsetBehavior = InSetupState.AimOffsetBehavior;
+	TurnStartAngle = InSetupState.TurnStartAngle;
+	TurnStopTolerance = InSetupState.TurnStopTolerance;
+
+	if(RotationMethod != InSetupState.RotationMethod)
+	{
+		RotationMethod = InSetupState.RotationMethod;
+		HandleRotationMethodChange();
+	}
+
+	if(RotationSpeed != InSetupState.RotationSpeed)
 	{
-		LookAtLocation = LookAt;
+		RotationSpeed = InSetupState.RotationSpeed;
+		HandleRotationSpeedChange();
 	}
 }
 
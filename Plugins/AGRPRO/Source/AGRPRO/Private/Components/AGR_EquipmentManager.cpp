@@ -1,11 +1,20 @@
 // Copyright Adam Grodzki All Rights Reserved.
 
 #include "Components/AGR_EquipmentManager.h"
-#include "BlueprintGameplayTagLibrary.h"
+#include "AGRLog.h"
+#include "Data/AGRComponentTableProvider.h"
+#include "Components/AGR_InventoryManager.h"
 #include "Components/AGR_ItemComponent.h"
 #include "Data/AGRLibrary.h"
 #include "Data/AGRTypes.h"
+#include "Data/DA_AGR_EquipmentSchema.h"
 #include "Net/UnrealNetwork.h"
+#include "Subsystems/AGR_ItemSubsystem.h"
+#include "SkeletalMeshMerge.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
+#include "GameFramework/Character.h"
+#include "TimerManager.h"
 
 UAGR_EquipmentManager::UAGR_EquipmentManager()
 {
@@ -16,9 +25,42 @@ UAGR_EquipmentManager::UAGR_EquipmentManager()
 	SetAutoActivate(true);
 }
 
+void UAGR_EquipmentManager::OnRegister()
+{
+	Super::OnRegister();
+
+	FAGRComponentTable::Update(this, &FAGRComponentTable::Equipment, true);
+}
+
+void UAGR_EquipmentManager::OnUnregister()
+{
+	FAGRComponentTable::Update(this, &FAGRComponentTable::Equipment, false);
+
+	Super::OnUnregister();
+}
+
 void UAGR_EquipmentManager::BeginPlay()
 {
 	Super::BeginPlay();
+
+	if(GetOwner()->HasAuthority())
+	{
+		// Construction scripts may still fill the deprecated list
+		ConvertLegacyEquipmentList();
+
+		Shortcuts.SetNum(FMath::Clamp(ShortcutCapacity, 0, static_cast<int32>(MAX_uint8) + 1));
+	}
+
+	// Slots defined in the editor: one entry per slot
+	if(GetOwner()->HasAuthority() && SlotEntries.Items.Num() != GetSlotDefinitions().Num())
+	{
+		ResetSlotEntries(TArray<AActor*>());
+	}
+	else
+	{
+		RebuildSlotMaps();
+		RebuildStats();
+	}
 }
 
 void UAGR_EquipmentManager::TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -30,14 +72,63 @@ void UAGR_EquipmentManager::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	DOREPLIFETIME(ThisClass, EquipmentList);
+	DOREPLIFETIME(ThisClass, SlotSchema);
+	DOREPLIFETIME(ThisClass, InlineSlots);
+	DOREPLIFETIME(ThisClass, SlotEntries);
+	DOREPLIFETIME_CONDITION(ThisClass, Shortcuts, COND_OwnerOnly);
+}
+
+void UAGR_EquipmentManager::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	// Set after the archetype copy, which would otherwise leave the owner pointing at the archetype
+	SlotEntries.Owner = this;
+}
+
+void UAGR_EquipmentManager::PostLoad()
+{
+	Super::PostLoad();
+
+	ConvertLegacyEquipmentList();
+}
+
+void UAGR_EquipmentManager::ConvertLegacyEquipmentList()
+{
+	if(EquipmentList.Num() == 0)
+	{
+		return;
+	}
+
+	// A schema or inline slots set up with the current version win over stale data
+	if(!IsValid(SlotSchema) && InlineSlots.Num() == 0)
+	{
+		const int32 NumSlots = FMath::Min(EquipmentList.Num(), static_cast<int32>(MAX_uint8) + 1);
+
+		InlineSlots.SetNum(NumSlots);
+		SlotEntries.Items.SetNum(NumSlots);
+		for(int32 i = 0; i < NumSlots; ++i)
+		{
+			InlineSlots[i].Id = EquipmentList[i].Id;
+			InlineSlots[i].AcceptableSlots = EquipmentList[i].AcceptableSlots;
+			InlineSlots[i].bCosmetic = EquipmentList[i].bCosmetic;
+			SlotEntries.Items[i].SlotIndex = static_cast<uint8>(i);
+			SlotEntries.Items[i].ItemActor = EquipmentList[i].ItemActor;
+		}
+
+		InlineAcceptance.Reset();
+		SlotEntries.MarkArrayDirty();
+		SlotMapsListNum = INDEX_NONE;
+	}
+
+	EquipmentList.Empty();
 }
 
 bool UAGR_EquipmentManager::GetAllItems(TArray<AActor*>& OutItems)
 {
-	OutItems.Reset(EquipmentList.Num());
+	OutItems.Reset(SlotEntries.Items.Num());
 
-	for(const FEquipment& EquipmentItem : EquipmentList)
+	for(const FAGREquipmentSlotEntry& EquipmentItem : SlotEntries.Items)
 	{
 		if(IsValid(EquipmentItem.ItemActor))
 		{
@@ -48,6 +139,35 @@ bool UAGR_EquipmentManager::GetAllItems(TArray<AActor*>& OutItems)
 	return OutItems.Num() > 0;
 }
 
+TArray<FEquipment> UAGR_EquipmentManager::GetEquipmentSlots() const
+{
+	const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions = GetSlotDefinitions();
+
+	TArray<FEquipment> EquipmentSlots;
+	EquipmentSlots.SetNum(SlotDefinitions.Num());
+	for(int32 i = 0; i < SlotDefinitions.Num(); ++i)
+	{
+		EquipmentSlots[i].Id = SlotDefinitions[i].Id;
+		EquipmentSlots[i].AcceptableSlots = SlotDefinitions[i].AcceptableSlots;
+		EquipmentSlots[i].bCosmetic = SlotDefinitions[i].bCosmetic;
+	}
+
+	for(const FAGREquipmentSlotEntry& Entry : SlotEntries.Items)
+	{
+		if(EquipmentSlots.IsValidIndex(Entry.SlotIndex))
+		{
+			EquipmentSlots[Entry.SlotIndex].ItemActor = Entry.ItemActor;
+		}
+	}
+
+	return EquipmentSlots;
+}
+
+const TArray<FAGREquipmentSlotDefinition>& UAGR_EquipmentManager::GetSlotDefinitions() const
+{
+	return IsValid(SlotSchema) ? SlotSchema->Slots : InlineSlots;
+}
+
 bool UAGR_EquipmentManager::EquipItemInSlot(const FName Slot, AActor* ItemActor, AActor*& OutPreviousItem, AActor*& OutNewItem)
 {
 	if (!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
@@ -55,190 +175,1265 @@ bool UAGR_EquipmentManager::EquipItemInSlot(const FName Slot, AActor* ItemActor,
 		return false;
 	}
 
-	AActor* ItemInSlot;
-	if(GetItemInSlot(Slot, ItemInSlot))
+	const int32 SlotIndex = FindSlotIndex(Slot);
+	UAGR_ItemComponent* ItemComponent = nullptr;
+	if(!CanEquipInSlot(SlotIndex, ItemActor, ItemComponent))
+	{
+		return false;
+	}
+
+	// All conditions are met -> Start to equip item
+
+	AActor* PreviousItemActor = GetSlotItem(SlotIndex);
+
+	// Skip unequip if item is NOT valid (empty slot!)
+	if(IsValid(PreviousItemActor))
 	{
-		if(ItemInSlot == ItemActor)
+		OutPreviousItem = PreviousItemActor;
+		UAGR_ItemComponent* PreviousItemComponent = UAGRLibrary::GetItemComponent(OutPreviousItem);
+		if(IsValid(PreviousItemComponent))
 		{
-			// Same item is already equipped
-			return false;
+			PreviousItemComponent->UnequipInternal();
 		}
 	}
-	
-	for(int32 i = 0; i < EquipmentList.Num(); ++i)
+
+	// An item can only be in one slot: moving it frees the slot it was in before
+	const int32 PreviousSlotIndex = FindItemSlotIndex(ItemActor);
+	if(PreviousSlotIndex != INDEX_NONE)
+	{
+		SetSlotItem(PreviousSlotIndex, nullptr);
+	}
+
+	SetSlotItem(SlotIndex, ItemActor);
+	OutNewItem = ItemActor;
+
+	ItemComponent->EquipInternal();
+
+	OnEquipmentChanged.Broadcast();
+
+	// Item equipped successfully
+	return true;
+}
+
+bool UAGR_EquipmentManager::ApplyLoadout(const TArray<FAGREquipmentLoadoutEntry>& Loadout, FText& OutNote)
+{
+	if (!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
+	{
+		return false;
+	}
+
+	const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions = GetSlotDefinitions();
+	const FAGREquipmentAcceptance& Acceptance = GetAcceptance();
+
+	TArray<AActor*, TInlineAllocator<16>> OldItems;
+	OldItems.SetNum(SlotDefinitions.Num());
+	for(int32 SlotIndex = 0; SlotIndex < SlotDefinitions.Num(); ++SlotIndex)
+	{
+		OldItems[SlotIndex] = GetSlotItem(SlotIndex);
+	}
+
+	/* Validate everything before touching a single slot */
+
+	TArray<AActor*, TInlineAllocator<16>> NewItems = OldItems;
+	TBitArray<> LoadoutSlots(false, SlotDefinitions.Num());
+	TSet<AActor*, DefaultKeyFuncs<AActor*>, TInlineSetAllocator<16>> LoadoutItems;
+
+	for(const FAGREquipmentLoadoutEntry& LoadoutEntry : Loadout)
 	{
-		const FEquipment& EquipmentElement = EquipmentList[i];
+		const int32 SlotIndex = FindSlotIndex(LoadoutEntry.Slot);
+		if(SlotIndex == INDEX_NONE)
+		{
+			// TODO OutNote should be an enum!
+			OutNote = FText::FromString(FString::Printf(TEXT("Slot %s not found"), *LoadoutEntry.Slot.ToString()));
+			return false;
+		}
 
-		if(Slot != EquipmentElement.Id)
+		if(LoadoutSlots[SlotIndex])
 		{
-			continue;
+			OutNote = FText::FromString(FString::Printf(TEXT("Slot %s used twice"), *LoadoutEntry.Slot.ToString()));
+			return false;
 		}
+		LoadoutSlots[SlotIndex] = true;
 
-		if(!ItemActor->ActorHasTag(UAGR_ItemComponent::TAG_ITEM))
+		AActor* ItemActor = LoadoutEntry.ItemActor;
+		NewItems[SlotIndex] = ItemActor;
+		if(ItemActor == nullptr)
 		{
 			continue;
 		}
 
+		bool bAlreadyInLoadout = false;
+		LoadoutItems.Add(ItemActor, &bAlreadyInLoadout);
+		if(bAlreadyInLoadout)
+		{
+			OutNote = FText::FromString(FString::Printf(TEXT("Item %s used twice"), *ItemActor->GetName()));
+			return false;
+		}
+
 		UAGR_ItemComponent* ItemComponent = UAGRLibrary::GetItemComponent(ItemActor);
-		if(!IsValid(ItemComponent))
+		if(!IsValid(ItemActor) || !ItemActor->ActorHasTag(UAGR_ItemComponent::TAG_ITEM) || !IsValid(ItemComponent))
 		{
-			continue;
+			OutNote = FText::FromString(FString::Printf(TEXT("Not a valid item in slot %s"), *LoadoutEntry.Slot.ToString()));
+			return false;
 		}
 
-		const bool bMatches = UBlueprintGameplayTagLibrary::MatchesAnyTags(
-			ItemComponent->ItemTagSlotType,
-			EquipmentElement.AcceptableSlots,
-			false);
-		if(!bMatches)
+		const uint64 ItemMask = Acceptance.GetItemMask(ItemComponent->ItemTagSlotType);
+		if(!Acceptance.IsSlotAcceptable(SlotDefinitions, SlotIndex, ItemMask, ItemComponent->ItemTagSlotType))
 		{
-			continue;
+			OutNote = FText::FromString(FString::Printf(TEXT("Item %s not accepted in slot %s"), *ItemActor->GetName(), *LoadoutEntry.Slot.ToString()));
+			return false;
 		}
+	}
+
+	// Items moved by the loadout leave the slots they were in before
+	for(int32 SlotIndex = 0; SlotIndex < SlotDefinitions.Num(); ++SlotIndex)
+	{
+		if(!LoadoutSlots[SlotIndex] && LoadoutItems.Contains(NewItems[SlotIndex]))
+		{
+			NewItems[SlotIndex] = nullptr;
+		}
+	}
 
-		// All conditions are met -> Start to equip item
+	/* Apply: unequip leaving items, write all slots, equip new items */
 
-		// Skip unequip if item is NOT valid (empty slot!)
-		if(IsValid(EquipmentElement.ItemActor))
+	for(AActor* OldItemActor : OldItems)
+	{
+		if(IsValid(OldItemActor) && !NewItems.Contains(OldItemActor))
 		{
-			OutPreviousItem = EquipmentElement.ItemActor;
-			UAGR_ItemComponent* PreviousItemComponent = UAGRLibrary::GetItemComponent(OutPreviousItem);
-			if(IsValid(PreviousItemComponent))
+			UAGR_ItemComponent* OldItemComponent = UAGRLibrary::GetItemComponent(OldItemActor);
+			if(IsValid(OldItemComponent))
 			{
-				PreviousItemComponent->UnequipInternal();
+				OldItemComponent->UnequipInternal();
 			}
 		}
+	}
 
-		EquipmentList[i].ItemActor = ItemActor;
-		OutNewItem = ItemActor;
+	for(int32 SlotIndex = 0; SlotIndex < SlotDefinitions.Num(); ++SlotIndex)
+	{
+		if(NewItems[SlotIndex] != OldItems[SlotIndex])
+		{
+			SetSlotItem(SlotIndex, NewItems[SlotIndex], false);
+		}
+	}
 
-		ItemComponent->EquipInternal();
+	for(AActor* NewItemActor : NewItems)
+	{
+		if(IsValid(NewItemActor) && !OldItems.Contains(NewItemActor))
+		{
+			UAGR_ItemComponent* NewItemComponent = UAGRLibrary::GetItemComponent(NewItemActor);
+			if(IsValid(NewItemComponent))
+			{
+				NewItemComponent->EquipInternal();
+			}
+		}
+	}
 
-		// Item equipped successfully
-		return true;
+	for(int32 SlotIndex = 0; SlotIndex < SlotDefinitions.Num(); ++SlotIndex)
+	{
+		if(NewItems[SlotIndex] != OldItems[SlotIndex])
+		{
+			OnEquipmentSlotChanged.Broadcast(SlotDefinitions[SlotIndex].Id, NewItems[SlotIndex]);
+		}
 	}
 
-	// Failed to equip item
-	return false;
+	OnEquipmentChanged.Broadcast();
+
+	OutNote = FText::FromString("Loadout applied");
+	return true;
 }
 
-void UAGR_EquipmentManager::SetupDefineSlots(const TArray<FEquipment> InEquipmentList)
+bool UAGR_EquipmentManager::CanEquipInSlot(const int32 SlotIndex, AActor* ItemActor, UAGR_ItemComponent*& OutItemComponent)
 {
-	if (!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
+	if(!IsValid(ItemActor) || !ItemActor->ActorHasTag(UAGR_ItemComponent::TAG_ITEM))
 	{
-		return;
+		return false;
+	}
+
+	if(SlotIndex == INDEX_NONE)
+	{
+		return false;
 	}
 
-	EquipmentList = InEquipmentList;
+	if(GetSlotItem(SlotIndex) == ItemActor)
+	{
+		// Same item is already equipped
+		return false;
+	}
+
+	OutItemComponent = UAGRLibrary::GetItemComponent(ItemActor);
+	if(!IsValid(OutItemComponent))
+	{
+		return false;
+	}
+
+	const FAGREquipmentAcceptance& Acceptance = GetAcceptance();
+	const uint64 ItemMask = Acceptance.GetItemMask(OutItemComponent->ItemTagSlotType);
+	return Acceptance.IsSlotAcceptable(
+		GetSlotDefinitions(),
+		SlotIndex,
+		ItemMask,
+		OutItemComponent->ItemTagSlotType);
 }
 
-bool UAGR_EquipmentManager::UnequipItemFromSlot(const FName Slot, AActor*& OutItemUnequipped)
+bool UAGR_EquipmentManager::PredictEquipItemInSlot(const FName Slot, AActor* ItemActor)
 {
-	if (!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
+	if(!IsValid(GetOwner()))
 	{
 		return false;
 	}
 
-	for(int32 i = 0; i < EquipmentList.Num(); ++i)
+	if(GetOwner()->HasAuthority())
 	{
-		FEquipment& EquipmentElement = EquipmentList[i];
+		AActor* PreviousItem = nullptr;
+		AActor* NewItem = nullptr;
+		return EquipItemInSlot(Slot, ItemActor, PreviousItem, NewItem);
+	}
 
-		if(Slot != EquipmentElement.Id)
-		{
-			continue;
-		}
+	// Only the owning client can reach the server
+	if(GetOwnerRole() != ROLE_AutonomousProxy)
+	{
+		return false;
+	}
 
-		if(!IsValid(EquipmentElement.ItemActor))
-		{
-			continue;
-		}
+	const int32 SlotIndex = FindSlotIndex(Slot);
+	UAGR_ItemComponent* ItemComponent = nullptr;
+	if(!CanEquipInSlot(SlotIndex, ItemActor, ItemComponent))
+	{
+		return false;
+	}
 
-		/* slot exists + item is an item + tag is acceptable in this slot */
+	FEquipmentPrediction& Prediction = PendingPredictions.AddDefaulted_GetRef();
+	Prediction.PredictionKey = GetNextPredictionKey();
 
-		OutItemUnequipped = EquipmentElement.ItemActor;
-		EquipmentElement.ItemActor = nullptr;
+	AActor* PreviousItemActor = GetSlotItem(SlotIndex);
+	if(IsValid(PreviousItemActor))
+	{
+		Prediction.ItemVisuals.Add({PreviousItemActor, PreviousItemActor->IsHidden(), false});
 
-		UAGR_ItemComponent* UnequippedItemComponent = UAGRLibrary::GetItemComponent(OutItemUnequipped);
-		if(IsValid(UnequippedItemComponent))
+		const UAGR_ItemComponent* PreviousItemComponent = UAGRLibrary::GetItemComponent(PreviousItemActor);
+		if(IsValid(PreviousItemComponent))
 		{
-			UnequippedItemComponent->UnequipInternal();
+			PreviousItemComponent->UnequipPredicted();
 		}
+	}
 
-		// Item unequipped successfully
-		return true;
+	// An item can only be in one slot: moving it frees the slot it was in before
+	const int32 PreviousSlotIndex = FindItemSlotIndex(ItemActor);
+	if(PreviousSlotIndex != INDEX_NONE)
+	{
+		PredictSlotItem(Prediction, PreviousSlotIndex, nullptr);
 	}
 
-	// Failed to unequip item
-	return false;
+	PredictSlotItem(Prediction, SlotIndex, ItemActor);
+
+	Prediction.ItemVisuals.Add({ItemActor, ItemActor->IsHidden(), true});
+	ItemComponent->EquipPredicted();
+
+	OnEquipmentChanged.Broadcast();
+
+	ServerPredictEquip(Slot, ItemActor, Prediction.PredictionKey);
+	return true;
 }
 
-bool UAGR_EquipmentManager::UnequipByReference(AActor* ItemActor, FText& OutNote)
+bool UAGR_EquipmentManager::PredictUnequipItemFromSlot(const FName Slot)
 {
-	if (!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
+	if(!IsValid(GetOwner()))
+	{
+		return false;
+	}
+
+	if(GetOwner()->HasAuthority())
+	{
+		AActor* ItemUnequipped = nullptr;
+		return UnequipItemFromSlot(Slot, ItemUnequipped);
+	}
+
+	// Only the owning client can reach the server
+	if(GetOwnerRole() != ROLE_AutonomousProxy)
 	{
 		return false;
 	}
 
+	const int32 SlotIndex = FindSlotIndex(Slot);
+	AActor* ItemActor = SlotIndex != INDEX_NONE ? GetSlotItem(SlotIndex) : nullptr;
 	if(!IsValid(ItemActor))
 	{
-		// TODO OutNote should be an enum!
-		OutNote = FText::FromString("Not a valid actor");
 		return false;
 	}
 
-	/* Remove from array */
+	FEquipmentPrediction& Prediction = PendingPredictions.AddDefaulted_GetRef();
+	Prediction.PredictionKey = GetNextPredictionKey();
+
+	PredictSlotItem(Prediction, SlotIndex, nullptr);
+
+	Prediction.ItemVisuals.Add({ItemActor, ItemActor->IsHidden(), false});
+	const UAGR_ItemComponent* ItemComponent = UAGRLibrary::GetItemComponent(ItemActor);
+	if(IsValid(ItemComponent))
+	{
+		ItemComponent->UnequipPredicted();
+	}
+
+	OnEquipmentChanged.Broadcast();
+
+	ServerPredictUnequip(Slot, Prediction.PredictionKey);
+	return true;
+}
+
+uint16 UAGR_EquipmentManager::GetNextPredictionKey()
+{
+	// 0 is never used so a default key is always invalid
+	LastPredictionKey = LastPredictionKey == MAX_uint16 ? 1 : LastPredictionKey + 1;
+	return LastPredictionKey;
+}
+
+void UAGR_EquipmentManager::PredictSlotItem(FEquipmentPrediction& Prediction, const int32 SlotIndex, AActor* ItemActor)
+{
+	Prediction.SlotChanges.Add({SlotIndex, GetSlotItem(SlotIndex), false});
+	SetSlotItem(SlotIndex, ItemActor);
+}
 
-	for(int32 i = 0; i < EquipmentList.Num(); ++i)
+void UAGR_EquipmentManager::RollbackPrediction(const FEquipmentPrediction& Prediction)
+{
+	for(int32 i = Prediction.SlotChanges.Num() - 1; i >= 0; --i)
 	{
-		FEquipment& EquipmentElement = EquipmentList[i];
+		const FPredictedSlotChange& SlotChange = Prediction.SlotChanges[i];
 
-		if(EquipmentElement.ItemActor != ItemActor)
+		// Slots the server updated since already hold the authoritative item
+		if(!SlotChange.bServerUpdated)
 		{
-			continue;
+			SetSlotItem(SlotChange.SlotIndex, SlotChange.PreviousItemActor.Get());
 		}
+	}
 
-		EquipmentElement.ItemActor = nullptr;
-
-		UAGR_ItemComponent* UnequippedItemComponent = UAGRLibrary::GetItemComponent(ItemActor);
-		if(IsValid(UnequippedItemComponent))
+	for(const FPredictedItemVisual& ItemVisual : Prediction.ItemVisuals)
+	{
+		const UAGR_ItemComponent* ItemComponent = UAGRLibrary::GetItemComponent(ItemVisual.ItemActor.Get());
+		if(IsValid(ItemComponent))
 		{
-			UnequippedItemComponent->UnequipInternal();
+			ItemComponent->RevertPredicted(ItemVisual.bWasHidden, ItemVisual.bPredictedEquip);
 		}
+	}
+
+	OnEquipmentChanged.Broadcast();
+}
 
-		// Unequipped successfully
-		OutNote = FText::FromString("Successfully unequiped");
+bool UAGR_EquipmentManager::IsItemOfOwner(AActor* ItemActor)
+{
+	if(!IsValid(ItemActor) || !IsValid(GetOwner()) || ItemActor->GetOwner() != GetOwner())
+	{
+		return false;
+	}
+
+	// Equipped items are detached from the inventory storage
+	if(FindItemSlotIndex(ItemActor) != INDEX_NONE)
+	{
 		return true;
 	}
 
-	// Failed to unequip
-	// TODO OutNote should be an enum!
-	OutNote = FText::FromString("Not in equipment");
-	return false;
+	UAGR_InventoryManager* InventoryManager = UAGRLibrary::GetInventory(GetOwner());
+	return IsValid(InventoryManager) && InventoryManager->HasExactItem(ItemActor);
 }
 
-bool UAGR_EquipmentManager::GetItemInSlot(const FName Slot, AActor*& OutItem)
+void UAGR_EquipmentManager::ServerPredictEquip_Implementation(const FName Slot, AActor* ItemActor, const uint16 PredictionKey)
 {
-	for(const FEquipment& EquimentElement : EquipmentList)
+	// Never trust the actor the client sent
+	if(FindSlotIndex(Slot) == INDEX_NONE || !IsItemOfOwner(ItemActor))
 	{
-		if(EquimentElement.Id != Slot)
-		{
-			continue;
-		}
+		ClientAckPrediction(PredictionKey, false);
+		return;
+	}
 
-		// Found matching slot ID
+	AActor* PreviousItem = nullptr;
+	AActor* NewItem = nullptr;
+	const bool bSuccess = EquipItemInSlot(Slot, ItemActor, PreviousItem, NewItem);
+	ClientAckPrediction(PredictionKey, bSuccess);
+}
 
-		if(!IsValid(EquimentElement.ItemActor))
-		{
-			// Failed to find item that is also valid
-			return false;
-		}
+void UAGR_EquipmentManager::ServerPredictUnequip_Implementation(const FName Slot, const uint16 PredictionKey)
+{
+	const int32 SlotIndex = FindSlotIndex(Slot);
+	if(SlotIndex == INDEX_NONE || !IsItemOfOwner(GetSlotItem(SlotIndex)))
+	{
+		ClientAckPrediction(PredictionKey, false);
+		return;
+	}
 
-		OutItem = EquimentElement.ItemActor;
+	AActor* ItemUnequipped = nullptr;
+	const bool bSuccess = UnequipItemFromSlot(Slot, ItemUnequipped);
+	ClientAckPrediction(PredictionKey, bSuccess);
+}
 
-		// Valid item found
-		return true;
+void UAGR_EquipmentManager::ClientAckPrediction_Implementation(const uint16 PredictionKey, const bool bAccepted)
+{
+	const int32 PredictionIndex = PendingPredictions.IndexOfByPredicate([PredictionKey](const FEquipmentPrediction& Prediction)
+	{
+		return Prediction.PredictionKey == PredictionKey;
+	});
+	if(PredictionIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	const FEquipmentPrediction Prediction = MoveTemp(PendingPredictions[PredictionIndex]);
+	PendingPredictions.RemoveAt(PredictionIndex);
+
+	// Accepted: the replicated slots and item state confirm what is already shown
+	if(!bAccepted)
+	{
+		RollbackPrediction(Prediction);
+	}
+}
+
+void UAGR_EquipmentManager::SetupDefineSlots(const TArray<FEquipment> InEquipmentList)
+{
+	if (!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
+	{
+		return;
+	}
+
+	SlotSchema = nullptr;
+	InlineAcceptance.Reset();
+
+	InlineSlots.SetNum(InEquipmentList.Num());
+	TArray<AActor*> ItemsBySlot;
+	ItemsBySlot.SetNum(InEquipmentList.Num());
+	for(int32 i = 0; i < InEquipmentList.Num(); ++i)
+	{
+		InlineSlots[i].Id = InEquipmentList[i].Id;
+		InlineSlots[i].AcceptableSlots = InEquipmentList[i].AcceptableSlots;
+		InlineSlots[i].bCosmetic = InEquipmentList[i].bCosmetic;
+		ItemsBySlot[i] = InEquipmentList[i].ItemActor;
+	}
+
+	ResetSlotEntries(ItemsBySlot);
+}
+
+void UAGR_EquipmentManager::SetSlotSchema(UDA_AGR_EquipmentSchema* InSlotSchema)
+{
+	if (!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
+	{
+		return;
+	}
+
+	if(SlotSchema == InSlotSchema)
+	{
+		return;
+	}
+
+	// Carry items over to the slots with the same id
+	const TArray<FEquipment> PreviousSlots = GetEquipmentSlots();
+
+	SlotSchema = InSlotSchema;
+	InlineSlots.Reset();
+	InlineAcceptance.Reset();
+
+	TArray<AActor*> ItemsBySlot;
+	ItemsBySlot.SetNumZeroed(GetSlotDefinitions().Num());
+	for(const FEquipment& PreviousSlot : PreviousSlots)
+	{
+		const int32 SlotIndex = FindSlotIndex(PreviousSlot.Id);
+		if(SlotIndex != INDEX_NONE)
+		{
+			ItemsBySlot[SlotIndex] = PreviousSlot.ItemActor;
+		}
 	}
 
-	// Failed to find item
-	return false;
+	ResetSlotEntries(ItemsBySlot);
+}
+
+bool UAGR_EquipmentManager::UnequipItemFromSlot(const FName Slot, AActor*& OutItemUnequipped)
+{
+	if (!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
+	{
+		return false;
+	}
+
+	const int32 SlotIndex = FindSlotIndex(Slot);
+	AActor* ItemActor = SlotIndex != INDEX_NONE ? GetSlotItem(SlotIndex) : nullptr;
+	if(!IsValid(ItemActor))
+	{
+		// Failed to unequip item
+		return false;
+	}
+
+	OutItemUnequipped = ItemActor;
+	SetSlotItem(SlotIndex, nullptr);
+
+	UAGR_ItemComponent* UnequippedItemComponent = UAGRLibrary::GetItemComponent(OutItemUnequipped);
+	if(IsValid(UnequippedItemComponent))
+	{
+		UnequippedItemComponent->UnequipInternal();
+	}
+
+	OnEquipmentChanged.Broadcast();
+
+	// Item unequipped successfully
+	return true;
+}
+
+bool UAGR_EquipmentManager::UnequipByReference(AActor* ItemActor, FText& OutNote)
+{
+	if (!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
+	{
+		return false;
+	}
+
+	if(!IsValid(ItemActor))
+	{
+		// TODO OutNote should be an enum!
+		OutNote = FText::FromString("Not a valid actor");
+		return false;
+	}
+
+	const int32 SlotIndex = FindItemSlotIndex(ItemActor);
+	if(SlotIndex == INDEX_NONE)
+	{
+		// Failed to unequip
+		// TODO OutNote should be an enum!
+		OutNote = FText::FromString("Not in equipment");
+		return false;
+	}
+
+	SetSlotItem(SlotIndex, nullptr);
+
+	UAGR_ItemComponent* UnequippedItemComponent = UAGRLibrary::GetItemComponent(ItemActor);
+	if(IsValid(UnequippedItemComponent))
+	{
+		UnequippedItemComponent->UnequipInternal();
+	}
+
+	OnEquipmentChanged.Broadcast();
+
+	// Unequipped successfully
+	OutNote = FText::FromString("Successfully unequiped");
+	return true;
+}
+
+bool UAGR_EquipmentManager::GetItemInSlot(const FName Slot, AActor*& OutItem)
+{
+	const int32 SlotIndex = FindSlotIndex(Slot);
+	if(SlotIndex == INDEX_NONE)
+	{
+		// Failed to find item
+		return false;
+	}
+
+	AActor* ItemActor = GetSlotItem(SlotIndex);
+	if(!IsValid(ItemActor))
+	{
+		// Failed to find item that is also valid
+		return false;
+	}
+
+	OutItem = ItemActor;
+
+	// Valid item found
+	return true;
+}
+
+bool UAGR_EquipmentManager::FindBestSlotsForItem(AActor* ItemActor, TArray<FName>& OutSlots)
+{
+	OutSlots.Reset();
+
+	UAGR_ItemComponent* ItemComponent = UAGRLibrary::GetItemComponent(ItemActor);
+	if(!IsValid(ItemComponent))
+	{
+		return false;
+	}
+
+	const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions = GetSlotDefinitions();
+	const FAGREquipmentAcceptance& Acceptance = GetAcceptance();
+	const uint64 ItemMask = Acceptance.GetItemMask(ItemComponent->ItemTagSlotType);
+
+	TArray<FName, TInlineAllocator<8>> OccupiedSlots;
+	for(int32 SlotIndex = 0; SlotIndex < SlotDefinitions.Num(); ++SlotIndex)
+	{
+		if(!Acceptance.IsSlotAcceptable(SlotDefinitions, SlotIndex, ItemMask, ItemComponent->ItemTagSlotType))
+		{
+			continue;
+		}
+
+		AActor* SlotItemActor = GetSlotItem(SlotIndex);
+		if(SlotItemActor == ItemActor)
+		{
+			continue;
+		}
+
+		if(IsValid(SlotItemActor))
+		{
+			OccupiedSlots.Add(SlotDefinitions[SlotIndex].Id);
+		}
+		else
+		{
+			OutSlots.Add(SlotDefinitions[SlotIndex].Id);
+		}
+	}
+
+	OutSlots.Append(OccupiedSlots);
+	return OutSlots.Num() > 0;
+}
+
+bool UAGR_EquipmentManager::GetSlotOfItem(AActor* ItemActor, FName& OutSlot)
+{
+	if(!IsValid(ItemActor))
+	{
+		return false;
+	}
+
+	const int32 SlotIndex = FindItemSlotIndex(ItemActor);
+	if(SlotIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	OutSlot = GetSlotDefinitions()[SlotIndex].Id;
+	return true;
+}
+
+void UAGR_EquipmentManager::RebuildSlotMaps()
+{
+	const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions = GetSlotDefinitions();
+
+	InlineSlotIndexMap.Reset();
+	if(!IsValid(SlotSchema))
+	{
+		for(int32 i = 0; i < InlineSlots.Num(); ++i)
+		{
+			// First slot wins for duplicated names, same as the old linear search
+			if(!InlineSlotIndexMap.Contains(InlineSlots[i].Id))
+			{
+				InlineSlotIndexMap.Add(InlineSlots[i].Id, i);
+			}
+		}
+	}
+
+	SlotEntryMap.Init(INDEX_NONE, SlotDefinitions.Num());
+	ItemSlotMap.Reset();
+
+	for(int32 i = 0; i < SlotEntries.Items.Num(); ++i)
+	{
+		const FAGREquipmentSlotEntry& Entry = SlotEntries.Items[i];
+		if(!SlotEntryMap.IsValidIndex(Entry.SlotIndex))
+		{
+			// Layout has not replicated yet or shrank
+			continue;
+		}
+
+		SlotEntryMap[Entry.SlotIndex] = i;
+
+		if(Entry.ItemActor != nullptr && !ItemSlotMap.Contains(Entry.ItemActor))
+		{
+			ItemSlotMap.Add(Entry.ItemActor, Entry.SlotIndex);
+		}
+	}
+
+	SlotMapsListNum = SlotEntries.Items.Num();
+}
+
+int32 UAGR_EquipmentManager::FindSlotIndex(const FName Slot)
+{
+	if(IsValid(SlotSchema))
+	{
+		return SlotSchema->FindSlotIndex(Slot);
+	}
+
+	const int32* SlotIndex = InlineSlotIndexMap.Find(Slot);
+	if(SlotIndex == nullptr && SlotEntryMap.Num() == InlineSlots.Num())
+	{
+		return INDEX_NONE;
+	}
+
+	if(SlotIndex != nullptr && InlineSlots.IsValidIndex(*SlotIndex) && InlineSlots[*SlotIndex].Id == Slot)
+	{
+		return *SlotIndex;
+	}
+
+	/* Layout was edited directly, rebuild and try once more */
+	RebuildSlotMaps();
+	SlotIndex = InlineSlotIndexMap.Find(Slot);
+	return SlotIndex != nullptr ? *SlotIndex : INDEX_NONE;
+}
+
+int32 UAGR_EquipmentManager::FindItemSlotIndex(const AActor* ItemActor)
+{
+	if(SlotMapsListNum != SlotEntries.Items.Num())
+	{
+		RebuildSlotMaps();
+	}
+
+	const int32* SlotIndex = ItemSlotMap.Find(ItemActor);
+	if(SlotIndex == nullptr)
+	{
+		return INDEX_NONE;
+	}
+
+	if(GetSlotItem(*SlotIndex) == ItemActor)
+	{
+		return *SlotIndex;
+	}
+
+	/* List was edited directly, rebuild and try once more */
+	RebuildSlotMaps();
+	SlotIndex = ItemSlotMap.Find(ItemActor);
+	return SlotIndex != nullptr ? *SlotIndex : INDEX_NONE;
+}
+
+int32 UAGR_EquipmentManager::FindEntryIndex(const int32 SlotIndex)
+{
+	if(SlotMapsListNum != SlotEntries.Items.Num() || SlotEntryMap.Num() != GetSlotDefinitions().Num())
+	{
+		RebuildSlotMaps();
+	}
+
+	if(!SlotEntryMap.IsValidIndex(SlotIndex))
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 EntryIndex = SlotEntryMap[SlotIndex];
+	if(SlotEntries.Items.IsValidIndex(EntryIndex) && SlotEntries.Items[EntryIndex].SlotIndex == SlotIndex)
+	{
+		return EntryIndex;
+	}
+
+	/* List was edited directly, rebuild and try once more */
+	RebuildSlotMaps();
+	return SlotEntryMap.IsValidIndex(SlotIndex) ? SlotEntryMap[SlotIndex] : INDEX_NONE;
+}
+
+const FAGREquipmentAcceptance& UAGR_EquipmentManager::GetAcceptance()
+{
+	if(IsValid(SlotSchema))
+	{
+		return SlotSchema->GetAcceptance();
+	}
+
+	if(!InlineAcceptance.IsBuilt())
+	{
+		InlineAcceptance.Build(InlineSlots);
+	}
+
+	return InlineAcceptance;
+}
+
+AActor* UAGR_EquipmentManager::GetSlotItem(const int32 SlotIndex)
+{
+	const int32 EntryIndex = FindEntryIndex(SlotIndex);
+	return EntryIndex != INDEX_NONE ? SlotEntries.Items[EntryIndex].ItemActor : nullptr;
+}
+
+void UAGR_EquipmentManager::SetSlotItem(const int32 SlotIndex, AActor* ItemActor, const bool bBroadcast)
+{
+	const int32 EntryIndex = FindEntryIndex(SlotIndex);
+	if(EntryIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	FAGREquipmentSlotEntry& Entry = SlotEntries.Items[EntryIndex];
+
+	AActor* PreviousItemActor = Entry.ItemActor;
+	if(PreviousItemActor != nullptr)
+	{
+		const int32* PreviousSlotIndex = ItemSlotMap.Find(PreviousItemActor);
+		if(PreviousSlotIndex != nullptr && *PreviousSlotIndex == SlotIndex)
+		{
+			ItemSlotMap.Remove(PreviousItemActor);
+		}
+	}
+
+	Entry.ItemActor = ItemActor;
+
+	// Predicting clients write locally only, the server owns replication state
+	if(GetOwner()->HasAuthority())
+	{
+		SlotEntries.MarkItemDirty(Entry);
+	}
+
+	if(ItemActor != nullptr)
+	{
+		ItemSlotMap.Add(ItemActor, SlotIndex);
+	}
+
+	UpdateSlotStats(SlotIndex, ItemActor);
+	RequestCosmeticRebuild(SlotIndex);
+
+	if(bBroadcast)
+	{
+		OnEquipmentSlotChanged.Broadcast(GetSlotDefinitions()[SlotIndex].Id, ItemActor);
+	}
+}
+
+void UAGR_EquipmentManager::UpdateSlotStats(const int32 SlotIndex, AActor* ItemActor, const bool bForce)
+{
+	if(SlotIndex < 0)
+	{
+		return;
+	}
+
+	if(!AppliedSlotStats.IsValidIndex(SlotIndex))
+	{
+		AppliedSlotStats.SetNum(SlotIndex + 1);
+	}
+
+	FAppliedSlotStats& Applied = AppliedSlotStats[SlotIndex];
+	if(!bForce && Applied.ItemKey == TObjectKey<AActor>(ItemActor))
+	{
+		return;
+	}
+
+	/* Take the previous item out */
+	if(Applied.bHasContribution)
+	{
+		RemoveSlotContribution(Applied);
+	}
+
+	Applied.ItemKey = TObjectKey<AActor>(ItemActor);
+
+	/* Put the new item in */
+	const UAGR_ItemComponent* ItemComponent = UAGRLibrary::GetItemComponent(ItemActor);
+	if(!IsValid(ItemComponent))
+	{
+		return;
+	}
+
+	Applied.Modifiers = ItemComponent->AttributeModifiers;
+	Applied.Weight = ItemComponent->Weight;
+	Applied.bHasContribution = true;
+
+	for(const FAGRItemAttributeModifier& Modifier : Applied.Modifiers)
+	{
+		FAGRAttributeAggregate& Aggregate = EquipmentStats.Attributes.FindOrAdd(Modifier.Attribute);
+		if(Modifier.Operation == EAGRAttributeModifierOp::Additive)
+		{
+			Aggregate.Sum += Modifier.Value;
+		}
+		else if(Modifier.Value == 0.0f)
+		{
+			Aggregate.NumZeroMultipliers++;
+		}
+		else
+		{
+			Aggregate.Product *= Modifier.Value;
+		}
+	}
+	EquipmentStats.TotalWeight += Applied.Weight;
+}
+
+void UAGR_EquipmentManager::RemoveSlotContribution(FAppliedSlotStats& Applied)
+{
+	for(const FAGRItemAttributeModifier& Modifier : Applied.Modifiers)
+	{
+		FAGRAttributeAggregate& Aggregate = EquipmentStats.Attributes.FindOrAdd(Modifier.Attribute);
+		if(Modifier.Operation == EAGRAttributeModifierOp::Additive)
+		{
+			Aggregate.Sum -= Modifier.Value;
+		}
+		else if(Modifier.Value == 0.0f)
+		{
+			Aggregate.NumZeroMultipliers--;
+		}
+		else
+		{
+			Aggregate.Product /= Modifier.Value;
+		}
+	}
+	EquipmentStats.TotalWeight -= Applied.Weight;
+
+	Applied.Modifiers.Reset();
+	Applied.Weight = 0.0f;
+	Applied.bHasContribution = false;
+}
+
+void UAGR_EquipmentManager::RebuildStats()
+{
+	// Start from scratch, also clears drift of the running products
+	EquipmentStats = FAGREquipmentStats();
+	AppliedSlotStats.Reset();
+	AppliedSlotStats.SetNum(GetSlotDefinitions().Num());
+
+	for(const FAGREquipmentSlotEntry& Entry : SlotEntries.Items)
+	{
+		UpdateSlotStats(Entry.SlotIndex, Entry.ItemActor, true);
+	}
+}
+
+float UAGR_EquipmentManager::GetEquipmentAttribute(const FGameplayTag Attribute, const float BaseValue) const
+{
+	const FAGRAttributeAggregate* Aggregate = EquipmentStats.Attributes.Find(Attribute);
+	return Aggregate != nullptr ? Aggregate->Evaluate(BaseValue) : BaseValue;
+}
+
+void UAGR_EquipmentManager::RefreshItemStats(AActor* ItemActor)
+{
+	const int32 SlotIndex = FindItemSlotIndex(ItemActor);
+	if(SlotIndex != INDEX_NONE)
+	{
+		UpdateSlotStats(SlotIndex, ItemActor, true);
+	}
+}
+
+void UAGR_EquipmentManager::ResetSlotEntries(const TArray<AActor*>& ItemsBySlot)
+{
+	const int32 NumSlots = FMath::Min(GetSlotDefinitions().Num(), static_cast<int32>(MAX_uint8) + 1);
+
+	SlotEntries.Items.SetNum(NumSlots);
+	for(int32 i = 0; i < NumSlots; ++i)
+	{
+		SlotEntries.Items[i].SlotIndex = static_cast<uint8>(i);
+		SlotEntries.Items[i].ItemActor = ItemsBySlot.IsValidIndex(i) ? ItemsBySlot[i] : nullptr;
+	}
+
+	SlotEntries.MarkArrayDirty();
+	RebuildSlotMaps();
+	RebuildStats();
+	RequestCosmeticRebuild(INDEX_NONE);
+
+	OnEquipmentChanged.Broadcast();
+}
+
+void UAGR_EquipmentManager::OnRep_SlotLayout()
+{
+	InlineAcceptance.Reset();
+	RebuildSlotMaps();
+	RebuildStats();
+	RequestCosmeticRebuild(INDEX_NONE);
+}
+
+void UAGR_EquipmentManager::OnSlotReplicated(const FAGREquipmentSlotEntry& Entry, const bool bRemoved)
+{
+	// Client order of the fast array may differ from the server, the maps are rebuilt on the next lookup
+	SlotMapsListNum = INDEX_NONE;
+
+	const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions = GetSlotDefinitions();
+	const FName Slot = SlotDefinitions.IsValidIndex(Entry.SlotIndex) ? SlotDefinitions[Entry.SlotIndex].Id : NAME_None;
+	AActor* ItemActor = bRemoved ? nullptr : Entry.ItemActor;
+
+	// Authoritative state arrived, pending predictions must not roll this slot back
+	for(FEquipmentPrediction& Prediction : PendingPredictions)
+	{
+		for(FPredictedSlotChange& SlotChange : Prediction.SlotChanges)
+		{
+			if(SlotChange.SlotIndex == Entry.SlotIndex)
+			{
+				SlotChange.bServerUpdated = true;
+			}
+		}
+	}
+
+	// Confirmed predictions were already reported
+	const bool bChanged = !AppliedSlotStats.IsValidIndex(Entry.SlotIndex) || AppliedSlotStats[Entry.SlotIndex].ItemKey != TObjectKey<AActor>(ItemActor);
+
+	UpdateSlotStats(Entry.SlotIndex, ItemActor);
+
+	if(bChanged)
+	{
+		RequestCosmeticRebuild(Entry.SlotIndex);
+		OnEquipmentSlotChanged.Broadcast(Slot, ItemActor);
+	}
+}
+
+void UAGR_EquipmentManager::OnEquipmentReplicated()
+{
+	OnEquipmentChanged.Broadcast();
+}
+
+void FAGREquipmentSlotEntry::PreReplicatedRemove(const FAGREquipmentList& InArraySerializer)
+{
+	if(IsValid(InArraySerializer.Owner))
+	{
+		InArraySerializer.Owner->OnSlotReplicated(*this, true);
+	}
+}
+
+void FAGREquipmentSlotEntry::PostReplicatedAdd(const FAGREquipmentList& InArraySerializer)
+{
+	if(IsValid(InArraySerializer.Owner))
+	{
+		InArraySerializer.Owner->OnSlotReplicated(*this, false);
+	}
+}
+
+void FAGREquipmentSlotEntry::PostReplicatedChange(const FAGREquipmentList& InArraySerializer)
+{
+	if(IsValid(InArraySerializer.Owner))
+	{
+		InArraySerializer.Owner->OnSlotReplicated(*this, false);
+	}
+}
+
+void FAGREquipmentList::PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters)
+{
+	if(IsValid(Owner))
+	{
+		Owner->OnEquipmentReplicated();
+	}
+}
+
+void UAGR_EquipmentManager::RequestCosmeticRebuild(const int32 SlotIndex)
+{
+	if(bCosmeticRebuildPending || (MeshMergeMode == EAGRMeshMergeMode::None && CosmeticMeshes.Num() == 0))
+	{
+		return;
+	}
+
+	// Nobody looks at meshes on a dedicated server
+	if(GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions = GetSlotDefinitions();
+	if(SlotDefinitions.IsValidIndex(SlotIndex) && !SlotDefinitions[SlotIndex].bCosmetic)
+	{
+		return;
+	}
+
+	UWorld* World = GetWorld();
+	if(!IsValid(World))
+	{
+		return;
+	}
+
+	// Deferred: several slots change in one frame (loadouts) and Blueprint attaches the items on OnEquip
+	bCosmeticRebuildPending = true;
+	World->GetTimerManager().SetTimerForNextTick(this, &UAGR_EquipmentManager::RebuildCosmeticMeshes);
+}
+
+void UAGR_EquipmentManager::RebuildCosmeticMeshes()
+{
+	bCosmeticRebuildPending = false;
+
+	ReleaseCosmeticMeshes();
+
+	USkeletalMeshComponent* OwnerMesh = GetOwnerMesh();
+	if(MeshMergeMode == EAGRMeshMergeMode::None || !IsValid(OwnerMesh))
+	{
+		return;
+	}
+
+	/* Collect the skeletal meshes of all items in cosmetic slots */
+
+	const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions = GetSlotDefinitions();
+	TArray<USkeletalMeshComponent*> ItemMeshComponents;
+	for(const FAGREquipmentSlotEntry& Entry : SlotEntries.Items)
+	{
+		if(!SlotDefinitions.IsValidIndex(Entry.SlotIndex) || !SlotDefinitions[Entry.SlotIndex].bCosmetic || !IsValid(Entry.ItemActor))
+		{
+			continue;
+		}
+
+		TArray<USkeletalMeshComponent*> Components;
+		Entry.ItemActor->GetComponents<USkeletalMeshComponent>(Components);
+		for(USkeletalMeshComponent* Component : Components)
+		{
+			if(IsValid(Component->SkeletalMesh))
+			{
+				ItemMeshComponents.Add(Component);
+			}
+		}
+	}
+
+	bool bMerged = false;
+	if(MeshMergeMode == EAGRMeshMergeMode::MergedMesh && ItemMeshComponents.Num() > 0)
+	{
+		TArray<USkeletalMesh*> SourceMeshes;
+		SourceMeshes.Reserve(ItemMeshComponents.Num());
+		for(const USkeletalMeshComponent* Component : ItemMeshComponents)
+		{
+			SourceMeshes.Add(Component->SkeletalMesh);
+		}
+
+		USkeletalMesh* MergedMesh = NewObject<USkeletalMesh>(this, NAME_None, RF_Transient);
+		MergedMesh->SetSkeleton(OwnerMesh->SkeletalMesh != nullptr ? OwnerMesh->SkeletalMesh->GetSkeleton() : SourceMeshes[0]->GetSkeleton());
+
+		FSkeletalMeshMerge MeshMerge(MergedMesh, SourceMeshes, TArray<FSkelMeshMergeSectionMapping>(), 0);
+		bMerged = MeshMerge.DoMerge();
+
+		if(bMerged)
+		{
+			if(!IsValid(MergedMeshComponent))
+			{
+				MergedMeshComponent = NewObject<USkeletalMeshComponent>(GetOwner(), TEXT("AGR_MergedCosmetics"), RF_Transient);
+				MergedMeshComponent->SetupAttachment(OwnerMesh);
+				MergedMeshComponent->RegisterComponent();
+				MergedMeshComponent->SetMasterPoseComponent(OwnerMesh);
+			}
+
+			MergedMeshComponent->SetSkeletalMesh(MergedMesh);
+		}
+		else
+		{
+			AGR_WARN(TEXT("%s: Merging cosmetic meshes failed, using leader pose"), *GetNameSafe(GetOwner()));
+		}
+	}
+
+	if(IsValid(MergedMeshComponent))
+	{
+		MergedMeshComponent->SetVisibility(bMerged);
+	}
+
+	/* Hide merged item meshes or let them follow the owner pose */
+
+	for(USkeletalMeshComponent* Component : ItemMeshComponents)
+	{
+		FCosmeticMesh& CosmeticMesh = CosmeticMeshes.AddDefaulted_GetRef();
+		CosmeticMesh.MeshComponent = Component;
+		CosmeticMesh.bMerged = bMerged;
+		CosmeticMesh.bWasTickEnabled = Component->IsComponentTickEnabled();
+
+		if(bMerged)
+		{
+			Component->SetVisibility(false);
+			Component->SetComponentTickEnabled(false);
+		}
+		else
+		{
+			Component->SetMasterPoseComponent(OwnerMesh);
+		}
+	}
+}
+
+void UAGR_EquipmentManager::ReleaseCosmeticMeshes()
+{
+	for(const FCosmeticMesh& CosmeticMesh : CosmeticMeshes)
+	{
+		USkeletalMeshComponent* Component = CosmeticMesh.MeshComponent.Get();
+		if(!IsValid(Component))
+		{
+			continue;
+		}
+
+		if(CosmeticMesh.bMerged)
+		{
+			Component->SetVisibility(true);
+			Component->SetComponentTickEnabled(CosmeticMesh.bWasTickEnabled);
+		}
+		else
+		{
+			Component->SetMasterPoseComponent(nullptr);
+		}
+	}
+
+	CosmeticMeshes.Reset();
+}
+
+USkeletalMeshComponent* UAGR_EquipmentManager::GetOwnerMesh() const
+{
+	const ACharacter* Character = Cast<ACharacter>(GetOwner());
+	if(IsValid(Character))
+	{
+		return Character->GetMesh();
+	}
+
+	return IsValid(GetOwner()) ? GetOwner()->FindComponentByClass<USkeletalMeshComponent>() : nullptr;
+}
+
+bool UAGR_EquipmentManager::SetShortcut(const int32 Index, AActor* Item)
+{
+	if(!Shortcuts.IsValidIndex(Index) || !IsValid(GetOwner()))
+	{
+		return false;
+	}
+
+	FGuid ItemId;
+	UAGR_ItemComponent* ItemComponent = nullptr;
+	if(Item != nullptr)
+	{
+		ItemComponent = UAGRLibrary::GetItemComponent(Item);
+		if(!IsValid(ItemComponent) || !ItemComponent->ItemId.IsValid())
+		{
+			return false;
+		}
+
+		// The server would reject it and no update would come to correct the local shortcut
+		if(!GetOwner()->HasAuthority() && !IsItemOfOwner(Item))
+		{
+			return false;
+		}
+
+		ItemId = ItemComponent->ItemId;
+	}
+
+	Shortcuts[Index] = ItemId;
+
+	if(ShortcutCache.Num() != Shortcuts.Num())
+	{
+		ShortcutCache.SetNum(Shortcuts.Num());
+	}
+	ShortcutCache[Index] = ItemComponent;
+
+	if(!GetOwner()->HasAuthority())
+	{
+		ServerSetShortcut(static_cast<uint8>(Index), ItemId);
+	}
+
+	return true;
+}
+
+bool UAGR_EquipmentManager::GetShortcut(const int32 Index, AActor*& OutItem)
+{
+	if(!Shortcuts.IsValidIndex(Index) || !Shortcuts[Index].IsValid())
+	{
+		return false;
+	}
+
+	if(ShortcutCache.Num() != Shortcuts.Num())
+	{
+		ShortcutCache.SetNum(Shortcuts.Num());
+	}
+
+	UAGR_ItemComponent* ItemComponent = ShortcutCache[Index].Get();
+	if(ItemComponent == nullptr || ItemComponent->ItemId != Shortcuts[Index])
+	{
+		// Destroyed, pooled with a new id or never resolved -> look the id up again
+		const UAGR_ItemSubsystem* ItemSubsystem = UAGR_ItemSubsystem::Get(this);
+		ItemComponent = IsValid(ItemSubsystem) ? ItemSubsystem->FindItemComponentById(Shortcuts[Index]) : nullptr;
+		ShortcutCache[Index] = ItemComponent;
+	}
+
+	if(ItemComponent == nullptr)
+	{
+		return false;
+	}
+
+	// Moved to another owner: keep the id, the item may come back
+	AActor* Item = ItemComponent->GetOwner();
+	if(!IsValid(Item) || Item->GetOwner() != GetOwner())
+	{
+		return false;
+	}
+
+	OutItem = Item;
+	return true;
+}
+
+void UAGR_EquipmentManager::ServerSetShortcut_Implementation(const uint8 Index, const FGuid ItemId)
+{
+	if(!Shortcuts.IsValidIndex(Index))
+	{
+		return;
+	}
+
+	// An invalid id clears the shortcut, any other id has to be an item of the owner
+	UAGR_ItemComponent* ItemComponent = nullptr;
+	if(ItemId.IsValid())
+	{
+		const UAGR_ItemSubsystem* ItemSubsystem = UAGR_ItemSubsystem::Get(this);
+		ItemComponent = IsValid(ItemSubsystem) ? ItemSubsystem->FindItemComponentById(ItemId) : nullptr;
+		if(!IsValid(ItemComponent) || !IsItemOfOwner(ItemComponent->GetOwner()))
+		{
+			return;
+		}
+	}
+
+	Shortcuts[Index] = ItemId;
+
+	if(ShortcutCache.Num() != Shortcuts.Num())
+	{
+		ShortcutCache.SetNum(Shortcuts.Num());
+	}
+	ShortcutCache[Index] = ItemComponent;
 }
 
 void UAGR_EquipmentManager::SaveShortcutReference(const FName Key, AActor* Item)
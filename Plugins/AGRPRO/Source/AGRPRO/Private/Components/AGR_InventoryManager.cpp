@@ -1,8 +1,10 @@
 // Copyright Adam Grodzki All Rights Reserved.
 
 #include "Components/AGR_InventoryManager.h"
+#include "Data/AGRComponentTableProvider.h"
 #include "Components/AGR_ItemComponent.h"
 #include "Data/AGRLibrary.h"
+#include "Engine/AssetManager.h"
 #include "GameFramework/PlayerState.h"
 #include "Kismet/KismetArrayLibrary.h"
 #include "Kismet/KismetGuidLibrary.h"
@@ -26,6 +28,20 @@ void UAGR_InventoryManager::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>
 	DOREPLIFETIME(ThisClass, InventoryStorage);
 }
 
+void UAGR_InventoryManager::OnRegister()
+{
+	Super::OnRegister();
+
+	FAGRComponentTable::Update(this, &FAGRComponentTable::Inventory, true);
+}
+
+void UAGR_InventoryManager::OnUnregister()
+{
+	FAGRComponentTable::Update(this, &FAGRComponentTable::Inventory, false);
+
+	Super::OnUnregister();
+}
+
 void UAGR_InventoryManager::BeginPlay()
 {
 	Super::BeginPlay();
@@ -41,6 +57,22 @@ void UAGR_InventoryManager::BeginPlay()
 	SetupInventoryStorageReference();
 }
 
+void UAGR_InventoryManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	/* Adds still loading are dropped with the inventory */
+	for(FAGRPendingItemAdd& PendingAdd : PendingItemAdds)
+	{
+		if(PendingAdd.Handle.IsValid())
+		{
+			PendingAdd.Handle->CancelHandle();
+		}
+	}
+
+	PendingItemAdds.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void UAGR_InventoryManager::SetupInventoryStorageReference()
 {
 	if(IsValid(InventoryStorage))
@@ -232,6 +264,106 @@ bool UAGR_InventoryManager::AddItemsOfClass(const TSubclassOf<AActor> Class, con
 	OutNote = FText::FromString("New items spawned and registered to inventory");
 	return true;}
 
+bool UAGR_InventoryManager::AddItemsOfSoftClass(const TSoftClassPtr<AActor> Class, const int32 Quantity, UPARAM(DisplayName = "Note") FText& OutNote)
+{
+	AActor* InventoryManagerOwner = GetOwner();
+	if (!IsValid(InventoryManagerOwner) || !InventoryManagerOwner->HasAuthority())
+	{
+		return false;
+	}
+
+	if(Class.IsNull())
+	{
+		OutNote = FText::FromString("No item class");
+		return false;
+	}
+
+	if(Quantity <= 0)
+	{
+		// Failed to add item to inventory
+		OutNote = FText::FromString("Quantity must be greater than zero");
+		return false;
+	}
+
+	/* Already in memory -> no need to wait */
+	if(UClass* LoadedClass = Class.Get())
+	{
+		return AddItemsOfClass(LoadedClass, Quantity, OutNote);
+	}
+
+	const int32 RequestId = ++LastPendingRequestId;
+
+	FAGRPendingItemAdd& PendingAdd = PendingItemAdds.AddDefaulted_GetRef();
+	PendingAdd.Class = Class;
+	PendingAdd.Quantity = Quantity;
+	PendingAdd.RequestId = RequestId;
+
+	/* The streamable manager may complete (and remove the pending add) right away, so look the entry up again */
+	TSharedPtr<FStreamableHandle> Handle = UAssetManager::GetStreamableManager().RequestAsyncLoad(
+		Class.ToSoftObjectPath(),
+		FStreamableDelegate::CreateUObject(this, &UAGR_InventoryManager::OnPendingItemClassLoaded, RequestId));
+
+	FAGRPendingItemAdd* QueuedAdd = PendingItemAdds.FindByPredicate([RequestId](const FAGRPendingItemAdd& Element)
+	{
+		return Element.RequestId == RequestId;
+	});
+	if(QueuedAdd != nullptr)
+	{
+		QueuedAdd->Handle = Handle;
+	}
+
+	OutNote = FText::FromString("Item class is loading, items will be added once it is loaded");
+	return true;
+}
+
+void UAGR_InventoryManager::OnPendingItemClassLoaded(const int32 RequestId)
+{
+	const int32 PendingIndex = PendingItemAdds.IndexOfByPredicate([RequestId](const FAGRPendingItemAdd& Element)
+	{
+		return Element.RequestId == RequestId;
+	});
+	if(PendingIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	const FAGRPendingItemAdd PendingAdd = PendingItemAdds[PendingIndex];
+	PendingItemAdds.RemoveAt(PendingIndex);
+
+	FText Note;
+	UClass* LoadedClass = PendingAdd.Class.Get();
+	const bool bSuccess = IsValid(LoadedClass) && AddItemsOfClass(LoadedClass, PendingAdd.Quantity, Note);
+
+	if(bDebug)
+	{
+		const FString Msg = FString::Printf(
+			TEXT("Pending add of %s finished: %s -- %s"),
+			*PendingAdd.Class.ToString(),
+			bSuccess ? TEXT("True") : TEXT("False"),
+			IsValid(LoadedClass) ? *Note.ToString() : TEXT("Failed to load item class"));
+		GEngine->AddOnScreenDebugMessage(
+			-1,
+			2.0f,
+			FColor::FromHex("00A8FFFF"),
+			Msg);
+		UE_LOG(LogTemp, Warning, TEXT("%s"), *Msg);
+	}
+}
+
+int32 UAGR_InventoryManager::GetPendingQuantityOfClass(const TSoftClassPtr<AActor> Class) const
+{
+	int32 PendingQuantity = 0;
+	for(const FAGRPendingItemAdd& PendingAdd : PendingItemAdds)
+	{
+		if(PendingAdd.Class == Class)
+		{
+			PendingQuantity += PendingAdd.Quantity;
+		}
+	}
+
+	return PendingQuantity;
+}
+
 bool UAGR_InventoryManager::RemoveItemsOfClass(const TSubclassOf<AActor> Class, const int32 Quantity, UPARAM(DisplayName = "Note") FText& OutNote)
 {
 	/* Non-negative stacks */
@@ -375,7 +507,7 @@ bool UAGR_InventoryManager::GetAllItemsOfClass(const TSubclassOf<AActor> Class,
 	return false;
 }
 
-bool UAGR_InventoryManager::HasEnoughItems(const TSubclassOf<AActor> Item, const int32 Quantity, UPARAM(DisplayName = "Note") FText& OutNote)
+bool UAGR_InventoryManager::HasEnoughItems(const TSubclassOf<AActor> Item, const int32 Quantity, UPARAM(DisplayName = "Note") FText& OutNote, const bool bIncludePending)
 {
 	/* Do this check before crafting to see if reduce stack will succeed */
 
@@ -387,8 +519,14 @@ bool UAGR_InventoryManager::HasEnoughItems(const TSubclassOf<AActor> Item, const
 
 	int32 QuantityMissing = Quantity;
 
+	/* Stacks still loading. Never used for removal, they can't be removed before they exist. */
+	if(bIncludePending && PendingItemAdds.Num() > 0)
+	{
+		QuantityMissing -= GetPendingQuantityOfClass(TSoftClassPtr<AActor>(Item.Get()));
+	}
+
 	TArray<AActor*> FilteredArray;
-	if(!GetAllItemsOfClass(Item, FilteredArray))
+	if(!GetAllItemsOfClass(Item, FilteredArray) && QuantityMissing > 0)
 	{
 		OutNote = FText::FromString("Has enough check failed: No items of such class found");
 		return false;
@@ -424,6 +562,30 @@ bool UAGR_InventoryManager::HasEnoughItems(const TSubclassOf<AActor> Item, const
 	return false;
 }
 
+bool UAGR_InventoryManager::HasEnoughItemsOfSoftClass(const TSoftClassPtr<AActor> Class, const int32 Quantity, UPARAM(DisplayName = "Note") FText& OutNote, const bool bIncludePending)
+{
+	/* Loaded classes may already have items, the regular check covers both */
+	if(Class.Get() != nullptr)
+	{
+		return HasEnoughItems(Class.Get(), Quantity, OutNote, bIncludePending);
+	}
+
+	if(Quantity <= 0)
+	{
+		OutNote = FText::FromString("Not enough Items. Quantity must be greater than zero");
+		return false;
+	}
+
+	if(bIncludePending && GetPendingQuantityOfClass(Class) >= Quantity)
+	{
+		OutNote = FText::FromString("Success! Got enough items");
+		return true;
+	}
+
+	OutNote = FText::FromString("Failed. Not enough items");
+	return false;
+}
+
 bool UAGR_InventoryManager::GetAllItemsOfTagSlotType(const FGameplayTag SlotTypeFilter, UPARAM(DisplayName = "ItemsWithTag") TArray<AActor*>& OutItemsWithTag)
 {
 	TArray<AActor*> ItemsOfSlot;
@@ -479,6 +641,7 @@ void UAGR_InventoryManager::AddItemToInventoryDirectly(AActor* Item)
 	}
 
 	ItemComponent->HideShowItem(true);
+	ItemComponent->UnregisterFromWorld();
 
 	/* Ownership to call functions */
 
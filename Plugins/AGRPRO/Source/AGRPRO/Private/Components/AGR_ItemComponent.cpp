@@ -1,12 +1,15 @@
 // Copyright Adam Grodzki All Rights Reserved.
 
 #include "Components/AGR_ItemComponent.h"
+#include "Data/AGRComponentTableProvider.h"
 #include "Components/AGR_EquipmentManager.h"
 #include "Components/AGR_InventoryManager.h"
 #include "Data/AGRLibrary.h"
 #include "Kismet/KismetGuidLibrary.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "Net/UnrealNetwork.h"
+#include "Subsystems/AGR_ItemSubsystem.h"
+#include "TimerManager.h"
 
 const FName UAGR_ItemComponent::TAG_ITEM = FName("Item");
 
@@ -35,6 +38,22 @@ void UAGR_ItemComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& O
 	DOREPLIFETIME(ThisClass, ItemName);
 	DOREPLIFETIME(ThisClass, bSimulateWhenDropped);
 	DOREPLIFETIME(ThisClass, ItemTagSlotType);
+	DOREPLIFETIME(ThisClass, AttributeModifiers);
+	DOREPLIFETIME(ThisClass, bStashed);
+}
+
+void UAGR_ItemComponent::OnRegister()
+{
+	Super::OnRegister();
+
+	FAGRComponentTable::Update(this, &FAGRComponentTable::ItemComponent, true);
+}
+
+void UAGR_ItemComponent::OnUnregister()
+{
+	FAGRComponentTable::Update(this, &FAGRComponentTable::ItemComponent, false);
+
+	Super::OnUnregister();
 }
 
 void UAGR_ItemComponent::BeginPlay()
@@ -50,6 +69,8 @@ void UAGR_ItemComponent::BeginPlay()
 		}
 	}
 
+	RefreshItemIdRegistration();
+
 	AActor* ItemComponentOwner = GetOwner();
 	if(!ensure(IsValid(ItemComponentOwner)))
 	{
@@ -61,9 +82,123 @@ void UAGR_ItemComponent::BeginPlay()
 
 	/* Tag item for easier queries - tags are not replicated so watch out what is "server=true" and what is just begin play */
 	ItemComponentOwner->Tags.AddUnique(TAG_ITEM);
+
+	/* Clients receiving an already stashed item */
+	if(bStashed)
+	{
+		ApplyStash(true);
+	}
+
+	/* Items placed in the level (no owner, not attached to any storage) are lying in the world from the start.
+	 * They are indexed for queries only, the dropped item lifecycle (merge, caps, despawn) is left to DropItem. */
+	if(ItemComponentOwner->HasAuthority()
+		&& !IsValid(ItemComponentOwner->GetOwner())
+		&& !IsValid(ItemComponentOwner->GetAttachParentActor()))
+	{
+		RegisterInWorld();
+	}
+}
+
+void UAGR_ItemComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UnregisterFromWorld();
+
+	UAGR_ItemSubsystem* ItemSubsystem = UAGR_ItemSubsystem::Get(this);
+	if(IsValid(ItemSubsystem) && RegisteredItemId.IsValid())
+	{
+		ItemSubsystem->UnregisterItemId(this, RegisteredItemId);
+	}
+	RegisteredItemId.Invalidate();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UAGR_ItemComponent::SetItemId(const FGuid NewItemId)
+{
+	if(!IsValid(GetOwner()) || !GetOwner()->HasAuthority())
+	{
+		return;
+	}
+
+	ItemId = NewItemId;
+	RefreshItemIdRegistration();
+}
+
+void UAGR_ItemComponent::RefreshItemIdRegistration()
+{
+	// Not playing yet, BeginPlay registers
+	if(!HasBegunPlay() || RegisteredItemId == ItemId)
+	{
+		return;
+	}
+
+	UAGR_ItemSubsystem* ItemSubsystem = UAGR_ItemSubsystem::Get(this);
+	if(!IsValid(ItemSubsystem))
+	{
+		return;
+	}
+
+	if(RegisteredItemId.IsValid())
+	{
+		ItemSubsystem->UnregisterItemId(this, RegisteredItemId);
+	}
+
+	ItemSubsystem->RegisterItemId(this, ItemId);
+	RegisteredItemId = ItemId;
+}
+
+void UAGR_ItemComponent::OnRep_ItemId()
+{
+	RefreshItemIdRegistration();
+}
+
+void UAGR_ItemComponent::RegisterInWorld(const bool bDropped)
+{
+	UAGR_ItemSubsystem* ItemSubsystem = UAGR_ItemSubsystem::Get(this);
+	if(IsValid(ItemSubsystem))
+	{
+		ItemSubsystem->RegisterDroppedItem(this, bDropped);
+	}
+}
+
+void UAGR_ItemComponent::UnregisterFromWorld()
+{
+	if(DroppedItemIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	UAGR_ItemSubsystem* ItemSubsystem = UAGR_ItemSubsystem::Get(this);
+	if(IsValid(ItemSubsystem))
+	{
+		ItemSubsystem->UnregisterDroppedItem(this);
+	}
+
+	DroppedItemIndex = INDEX_NONE;
+
+	UPrimitiveComponent* PrimitiveComponent = IsValid(GetOwner()) ? Cast<UPrimitiveComponent>(GetOwner()->GetRootComponent()) : nullptr;
+	if(IsValid(PrimitiveComponent))
+	{
+		PrimitiveComponent->OnComponentSleep.RemoveDynamic(this, &UAGR_ItemComponent::OnDroppedItemSleep);
+	}
+}
+
+void UAGR_ItemComponent::RefreshWorldLocation()
+{
+	/* Only refresh items that are still lying in the world */
+	if(DroppedItemIndex != INDEX_NONE)
+	{
+		RegisterInWorld();
+	}
 }
 
-void UAGR_ItemComponent::HideShowItem(const bool bHide) const
+void UAGR_ItemComponent::OnDroppedItemSleep(UPrimitiveComponent* SleepingComponent, FName BoneName)
+{
+	/* Physics came to rest -> index the final location */
+	RefreshWorldLocation();
+}
+
+void UAGR_ItemComponent::HideShowItem(const bool bHide)
 {
 	AActor* ItemComponentOwner = GetOwner();
 	if(!IsValid(ItemComponentOwner) || !ItemComponentOwner->HasAuthority())
@@ -81,6 +216,13 @@ void UAGR_ItemComponent::HideShowItem(const bool bHide) const
 	}
 	else
 	{
+		/* Components must be registered again before they are moved back into the world */
+		if(bStashed)
+		{
+			bStashed = false;
+			ApplyStash(false);
+		}
+
 		const FDetachmentTransformRules DetachmentRules(EDetachmentRule::KeepWorld, true);
 		ItemComponentOwner->DetachFromActor(DetachmentRules);
 	}
@@ -88,10 +230,56 @@ void UAGR_ItemComponent::HideShowItem(const bool bHide) const
 	ItemComponentOwner->SetActorHiddenInGame(bHide);
 	ItemComponentOwner->SetActorEnableCollision(!bHide);
 
+	if(bHide && bStashWhenHidden && !bStashed)
+	{
+		bStashed = true;
+		ApplyStash(true);
+	}
+
 	OnHiddenShown.Broadcast(bHide);
 }
 
-void UAGR_ItemComponent::EquipInternal() const
+void UAGR_ItemComponent::ApplyStash(const bool bStash)
+{
+	AActor* ItemComponentOwner = GetOwner();
+	if(!IsValid(ItemComponentOwner))
+	{
+		return;
+	}
+
+	if(bStash)
+	{
+		/* Unregistering destroys render state, physics state and tick registration of each component */
+		TInlineComponentArray<UPrimitiveComponent*> PrimitiveComponents(ItemComponentOwner);
+		for(UPrimitiveComponent* PrimitiveComponent : PrimitiveComponents)
+		{
+			if(IsValid(PrimitiveComponent) && PrimitiveComponent->IsRegistered())
+			{
+				PrimitiveComponent->UnregisterComponent();
+				StashedComponents.Add(PrimitiveComponent);
+			}
+		}
+	}
+	else
+	{
+		for(UPrimitiveComponent* PrimitiveComponent : StashedComponents)
+		{
+			if(IsValid(PrimitiveComponent) && !PrimitiveComponent->IsRegistered())
+			{
+				PrimitiveComponent->RegisterComponent();
+			}
+		}
+
+		StashedComponents.Reset();
+	}
+}
+
+void UAGR_ItemComponent::OnRep_Stashed()
+{
+	ApplyStash(bStashed);
+}
+
+void UAGR_ItemComponent::EquipInternal()
 {
 	AActor* ItemActor = GetOwner();
 	if(!IsValid(ItemActor) || !ItemActor->HasAuthority())
@@ -155,6 +343,88 @@ void UAGR_ItemComponent::UnequipInternal() const
 	OnUnequip.Broadcast(ItemOwner);
 }
 
+void UAGR_ItemComponent::EquipPredicted() const
+{
+	AActor* ItemActor = GetOwner();
+	if(!IsValid(ItemActor) || ItemActor->HasAuthority())
+	{
+		return;
+	}
+
+	AActor* ParentItemActor = ItemActor->GetOwner();
+	if(!IsValid(ParentItemActor))
+	{
+		return;
+	}
+
+	/* Mirrors EquipInternal locally. Stashed items stay invisible until the server unstashes them. */
+	const FDetachmentTransformRules DetachmentRules(EDetachmentRule::KeepWorld, true);
+	ItemActor->DetachFromActor(DetachmentRules);
+	ItemActor->SetActorHiddenInGame(false);
+	ItemActor->SetActorEnableCollision(true);
+
+	UPrimitiveComponent* PrimitiveComponent = Cast<UPrimitiveComponent>(ItemActor->GetRootComponent());
+	if(IsValid(PrimitiveComponent))
+	{
+		PrimitiveComponent->SetSimulatePhysics(false);
+	}
+
+	OnEquip.Broadcast(ParentItemActor);
+}
+
+void UAGR_ItemComponent::UnequipPredicted() const
+{
+	AActor* ItemComponentOwner = GetOwner();
+	if(!IsValid(ItemComponentOwner) || ItemComponentOwner->HasAuthority())
+	{
+		return;
+	}
+
+	AActor* ItemOwner = ItemComponentOwner->GetOwner();
+	if(!IsValid(ItemOwner))
+	{
+		return;
+	}
+
+	/* Mirrors UnequipInternal locally. The storage is replicated, it is never spawned on clients. */
+	UAGR_InventoryManager* InventoryManager = UAGRLibrary::GetInventory(ItemOwner);
+	if(IsValid(InventoryManager) && IsValid(InventoryManager->InventoryStorage))
+	{
+		const FAttachmentTransformRules AttachmentRules(
+			EAttachmentRule::SnapToTarget,
+			EAttachmentRule::SnapToTarget,
+			EAttachmentRule::KeepWorld,
+			false);
+		ItemComponentOwner->AttachToActor(InventoryManager->InventoryStorage, AttachmentRules, NAME_None);
+	}
+
+	OnUnequip.Broadcast(ItemOwner);
+}
+
+void UAGR_ItemComponent::RevertPredicted(const bool bWasHidden, const bool bPredictedEquip) const
+{
+	AActor* ItemActor = GetOwner();
+	if(!IsValid(ItemActor) || ItemActor->HasAuthority())
+	{
+		return;
+	}
+
+	/* Attachment and visibility did not change on the server, so no update will come to correct them */
+	ItemActor->OnRep_AttachmentReplication();
+	ItemActor->SetActorHiddenInGame(bWasHidden);
+	ItemActor->SetActorEnableCollision(!bWasHidden);
+
+	AActor* ItemOwner = ItemActor->GetOwner();
+	if(bPredictedEquip)
+	{
+		OnUnequip.Broadcast(ItemOwner);
+	}
+	else
+	{
+		OnEquip.Broadcast(ItemOwner);
+	}
+}
+
 void UAGR_ItemComponent::TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
@@ -230,6 +500,7 @@ void UAGR_ItemComponent::PickUpItem(UAGR_InventoryManager* InventoryPicking)
 		/* Non-fungible non-stackable pickup */
 
 		HideShowItem(true);
+		UnregisterFromWorld();
 
 		AActor* ItemActorOwner = ItemActor->GetOwner();
 		if(IsValid(ItemActorOwner))
@@ -309,25 +580,22 @@ void UAGR_ItemComponent::DropItem()
 	{
 		/* Do an equipment check */
 
-		TArray<AActor*> FoundItems;
-		if(EquipmentManager->GetAllItems(FoundItems))
+		FName EquippedSlot;
+		if(EquipmentManager->GetSlotOfItem(ItemActor, EquippedSlot))
 		{
-			if(FoundItems.Contains(ItemActor))
+			FText Note;
+			const bool bSuccess = EquipmentManager->UnequipByReference(ItemActor, Note);
+
+			UAGR_InventoryManager* InventoryManager = UAGRLibrary::GetInventory(ItemActorOwner);
+			if(IsValid(InventoryManager) && InventoryManager->bDebug)
 			{
-				FText Note;
-				const bool bSuccess = EquipmentManager->UnequipByReference(ItemActor, Note);
-
-				UAGR_InventoryManager* InventoryManager = UAGRLibrary::GetInventory(ItemActorOwner);
-				if(IsValid(InventoryManager) && InventoryManager->bDebug)
-				{
-					const FString Msg = FString::Printf(TEXT("Unequip item: %s -- %s"), bSuccess ? TEXT("True") : TEXT("False"), *Note.ToString());
-					GEngine->AddOnScreenDebugMessage(
-						-1,
-						2.0f,
-						FColor::FromHex("00A8FFFF"),
-						Msg);
-					UE_LOG(LogTemp, Warning, TEXT("%s"), *Msg);
-				}
+				const FString Msg = FString::Printf(TEXT("Unequip item: %s -- %s"), bSuccess ? TEXT("True") : TEXT("False"), *Note.ToString());
+				GEngine->AddOnScreenDebugMessage(
+					-1,
+					2.0f,
+					FColor::FromHex("00A8FFFF"),
+					Msg);
+				UE_LOG(LogTemp, Warning, TEXT("%s"), *Msg);
 			}
 		}
 	}
@@ -346,11 +614,26 @@ void UAGR_ItemComponent::DropItem()
 	UPrimitiveComponent* PrimitiveComponent = Cast<UPrimitiveComponent>(ItemActor->GetRootComponent());
 	if(IsValid(PrimitiveComponent))
 	{
+		if(bSimulateWhenDropped)
+		{
+			/* OnComponentSleep is only broadcast for bodies that generate wake events */
+			PrimitiveComponent->BodyInstance.bGenerateWakeEvents = true;
+		}
+
 		PrimitiveComponent->SetSimulatePhysics(bSimulateWhenDropped);
+
+		if(bSimulateWhenDropped)
+		{
+			PrimitiveComponent->OnComponentSleep.AddUniqueDynamic(this, &UAGR_ItemComponent::OnDroppedItemSleep);
+		}
 	}
 
 	InventoryId.Invalidate();
 
+	/* Index at the owner's position now and again next frame, after the owner had the chance to place the item */
+	RegisterInWorld(true);
+	GetWorld()->GetTimerManager().SetTimerForNextTick(this, &UAGR_ItemComponent::RefreshWorldLocation);
+
 	OnItemDropped.Broadcast();
 }
 
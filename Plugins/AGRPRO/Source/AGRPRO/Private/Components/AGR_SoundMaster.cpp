@@ -1,6 +1,9 @@
 // Copyright Adam Grodzki All Rights Reserved.
 
 #include "Components/AGR_SoundMaster.h"
+#include "Data/AGRAnimSettings.h"
+#include "Data/AGRComponentTableProvider.h"
+#include "Subsystems/AGR_AnimMasterSubsystem.h"
 
 #include "DrawDebugHelpers.h"
 #include "Kismet/KismetMathLibrary.h"
@@ -16,11 +19,46 @@ UAGR_SoundMaster::UAGR_SoundMaster()
 	PrimaryComponentTick.bCanEverTick = true;
 }
 
+void UAGR_SoundMaster::OnRegister()
+{
+	Super::OnRegister();
+
+	FAGRComponentTable::Update(this, &FAGRComponentTable::Sound, true);
+}
+
+void UAGR_SoundMaster::OnUnregister()
+{
+	FAGRComponentTable::Update(this, &FAGRComponentTable::Sound, false);
+
+	Super::OnUnregister();
+}
+
 void UAGR_SoundMaster::BeginPlay()
 {
 	Super::BeginPlay();
 
 	RecastOwner();
+
+	if(UAGR_AnimMasterSubsystem* AnimMasterSubsystem = UAGR_AnimMasterSubsystem::Get(this))
+	{
+		AnimMasterSubsystem->RegisterSignificance(GetOwner());
+	}
+}
+
+void UAGR_SoundMaster::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if(UAGR_AnimMasterSubsystem* AnimMasterSubsystem = UAGR_AnimMasterSubsystem::Get(this))
+	{
+		AnimMasterSubsystem->UnregisterSignificance(GetOwner());
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UAGR_SoundMaster::ApplySignificanceBucket(const FAGRSignificanceBucket* Bucket)
+{
+	bFootstepsSignificant = Bucket != nullptr && Bucket->bFootsteps;
+	SetComponentTickEnabled(bFootstepsSignificant);
 }
 
 void UAGR_SoundMaster::TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -41,6 +79,7 @@ void UAGR_SoundMaster::RecastOwner()
 	}
 
 	OwnerAsCharacter = Cast<ACharacter>(GetOwner());
+	TraceContext.Initialize(GetOwner(), SCENE_QUERY_STAT_NAME_ONLY(AGRFootstepTrace));
 }
 
 void UAGR_SoundMaster::TestAllFeetForCollision()
@@ -96,6 +135,11 @@ void UAGR_SoundMaster::CloseAutofootstepGate()
 
 bool UAGR_SoundMaster::TryTraceFootstep(const FName Key)
 {
+	if(!bFootstepsSignificant)
+	{
+		return false;
+	}
+
 	if(!IsValid(OwnerAsCharacter))
 	{
 		RecastOwner();
@@ -140,16 +184,7 @@ bool UAGR_SoundMaster::TryTraceFootstep(const FName Key)
 	const FVector Start = OwnerAsCharacter->GetMesh()->GetSocketLocation(SocketName);
 	const FVector End = Start + FVector(0, 0, SurfaceTraceLength * -1);
 
-	TArray<AActor*> IgnoredActors;
-	OwnerAsCharacter->GetAttachedActors(IgnoredActors, true);
-
-	TArray<AActor*> CachedArray;
-	CachedArray.Add(OwnerAsCharacter);
-	CachedArray.Append(IgnoredActors);
-
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActors(CachedArray);
-	QueryParams.AddIgnoredActor(GetOwner());
+	FCollisionQueryParams& QueryParams = TraceContext.GetQueryParams();
 	QueryParams.bTraceComplex = bTraceComplex;
 	QueryParams.bReturnPhysicalMaterial = true;
 	#if WITH_EDITOR
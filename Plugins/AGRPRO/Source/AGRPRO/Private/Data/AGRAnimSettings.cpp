@@ -0,0 +1,33 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#include "Data/AGRAnimSettings.h"
+
+UAGRAnimSettings::UAGRAnimSettings()
+{
+	// Sets default values
+	bUseSignificance = false;
+	NotRenderedDistanceScale = 2.0f;
+	bUpdateSignificanceManager = true;
+	bManageAnimMasterTicks = false;
+
+	FAGRSignificanceBucket& Near = SignificanceBuckets.AddDefaulted_GetRef();
+	Near.MaxDistance = 2500.0f;
+
+	FAGRSignificanceBucket& Mid = SignificanceBuckets.AddDefaulted_GetRef();
+	Mid.MaxDistance = 8000.0f;
+	Mid.AimTickInterval = 0.1f;
+	Mid.bFootsteps = false;
+}
+
+int32 UAGRAnimSettings::GetSignificanceBucket(const float Distance) const
+{
+	for(int32 Index = 0; Index < SignificanceBuckets.Num(); Index++)
+	{
+		if(Distance < SignificanceBuckets[Index].MaxDistance)
+		{
+			return Index;
+		}
+	}
+
+	return INDEX_NONE;
+}
@@ -0,0 +1,3 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#include "Data/AGRComponentTableProvider.h"
@@ -0,0 +1,18 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#include "Data/AGRItemSettings.h"
+
+UAGRItemSettings::UAGRItemSettings()
+{
+	// Sets default values
+	GridCellSize = 500.0f;
+	bManageDroppedItems = false;
+	MaxItemsProcessedPerFrame = 64;
+	bMergeStackables = false;
+	MergeRadius = 150.0f;
+	SettleTime = 3.0f;
+	SettleSpeed = 5.0f;
+	MaxDroppedItemAge = 0.0f;
+	MaxItemsPerCell = 0;
+	ProtectedDespawnPriority = 100;
+}
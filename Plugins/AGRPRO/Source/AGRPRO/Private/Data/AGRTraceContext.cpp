@@ -0,0 +1,76 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#include "Data/AGRTraceContext.h"
+
+#include "Camera/PlayerCameraManager.h"
+#include "Components/SceneComponent.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+
+void FAGRTraceContext::Initialize(AActor* InOwner, const FName TraceTag)
+{
+	Owner = InOwner;
+	QueryParams = FCollisionQueryParams(TraceTag, false, InOwner);
+	AttachmentSignature = 0;
+	bIgnoreListDirty = true;
+	CameraController.Reset();
+	CameraManager.Reset();
+}
+
+FCollisionQueryParams& FAGRTraceContext::GetQueryParams()
+{
+	const AActor* OwnerActor = Owner.Get();
+	if(!IsValid(OwnerActor))
+	{
+		return QueryParams;
+	}
+
+	// Walking the attachment tree is cheap compared to collecting the attached actors and rebuilding the params
+	const uint32 Signature = GetAttachmentSignature(OwnerActor->GetRootComponent());
+	if(bIgnoreListDirty || Signature != AttachmentSignature)
+	{
+		OwnerActor->GetAttachedActors(AttachedActors, true);
+
+		QueryParams.ClearIgnoredActors();
+		QueryParams.AddIgnoredActor(OwnerActor);
+		QueryParams.AddIgnoredActors(AttachedActors);
+
+		AttachmentSignature = Signature;
+		bIgnoreListDirty = false;
+	}
+
+	return QueryParams;
+}
+
+APlayerCameraManager* FAGRTraceContext::GetCameraManager()
+{
+	const APawn* OwnerPawn = Cast<APawn>(Owner.Get());
+	AController* Controller = IsValid(OwnerPawn) ? OwnerPawn->GetController() : nullptr;
+
+	if(Controller != CameraController.Get() || !CameraManager.IsValid())
+	{
+		const APlayerController* PlayerController = Cast<APlayerController>(Controller);
+		CameraController = Controller;
+		CameraManager = IsValid(PlayerController) ? PlayerController->PlayerCameraManager : nullptr;
+	}
+
+	return CameraManager.Get();
+}
+
+uint32 FAGRTraceContext::GetAttachmentSignature(const USceneComponent* Component)
+{
+	if(!IsValid(Component))
+	{
+		return 0;
+	}
+
+	uint32 Signature = 0;
+	const int32 NumChildren = Component->GetNumChildrenComponents();
+	for(int32 Index = 0; Index < NumChildren; Index++)
+	{
+		const USceneComponent* Child = Component->GetChildComponent(Index);
+		Signature = HashCombine(Signature, HashCombine(PointerHash(Child), GetAttachmentSignature(Child)));
+	}
+
+	return Signature;
+}
@@ -0,0 +1,124 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#include "Data/DA_AGR_EquipmentSchema.h"
+#include "BlueprintGameplayTagLibrary.h"
+#include "GameplayTagsManager.h"
+
+void FAGREquipmentAcceptance::Build(const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions)
+{
+	TagMasks.Reset();
+
+	const UGameplayTagsManager& TagsManager = UGameplayTagsManager::Get();
+
+	const int32 NumMaskedSlots = FMath::Min(SlotDefinitions.Num(), MaxMaskedSlots);
+	for(int32 SlotIndex = 0; SlotIndex < NumMaskedSlots; ++SlotIndex)
+	{
+		const uint64 SlotBit = 1ull << SlotIndex;
+
+		for(const FGameplayTag& AcceptableTag : SlotDefinitions[SlotIndex].AcceptableSlots)
+		{
+			TagMasks.FindOrAdd(AcceptableTag) |= SlotBit;
+
+			// Items tagged with a child tag are accepted as well
+			const FGameplayTagContainer ChildTags = TagsManager.RequestGameplayTagChildren(AcceptableTag);
+			for(const FGameplayTag& ChildTag : ChildTags)
+			{
+				TagMasks.FindOrAdd(ChildTag) |= SlotBit;
+			}
+		}
+	}
+
+	bBuilt = true;
+}
+
+void FAGREquipmentAcceptance::Reset()
+{
+	TagMasks.Reset();
+	bBuilt = false;
+}
+
+uint64 FAGREquipmentAcceptance::GetItemMask(const FGameplayTag& ItemTag) const
+{
+	const uint64* TagMask = TagMasks.Find(ItemTag);
+	return TagMask != nullptr ? *TagMask : 0;
+}
+
+bool FAGREquipmentAcceptance::IsSlotAcceptable(
+	const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions,
+	const int32 SlotIndex,
+	const uint64 ItemMask,
+	const FGameplayTag& ItemTag) const
+{
+	if(!SlotDefinitions.IsValidIndex(SlotIndex))
+	{
+		return false;
+	}
+
+	if(SlotIndex < MaxMaskedSlots)
+	{
+		return (ItemMask & (1ull << SlotIndex)) != 0;
+	}
+
+	return UBlueprintGameplayTagLibrary::MatchesAnyTags(ItemTag, SlotDefinitions[SlotIndex].AcceptableSlots, false);
+}
+
+void UDA_AGR_EquipmentSchema::PostLoad()
+{
+	Super::PostLoad();
+
+	BuildLookup();
+}
+
+#if WITH_EDITOR
+void UDA_AGR_EquipmentSchema::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	BuildLookup();
+}
+#endif
+
+int32 UDA_AGR_EquipmentSchema::FindSlotIndex(const FName Slot) const
+{
+	// Lookup is stale (schema created or changed at runtime) -> fall back to a search
+	if(SlotIndexMap.Num() != Slots.Num())
+	{
+		return Slots.IndexOfByPredicate([Slot](const FAGREquipmentSlotDefinition& Definition)
+		{
+			return Definition.Id == Slot;
+		});
+	}
+
+	const int32* SlotIndex = SlotIndexMap.Find(Slot);
+	return SlotIndex != nullptr ? *SlotIndex : INDEX_NONE;
+}
+
+void UDA_AGR_EquipmentSchema::BuildLookup()
+{
+	SlotIndexMap.Reset();
+	Acceptance.Reset();
+
+	for(int32 i = 0; i < Slots.Num(); ++i)
+	{
+		// First slot wins for duplicated names
+		if(!SlotIndexMap.Contains(Slots[i].Id))
+		{
+			SlotIndexMap.Add(Slots[i].Id, i);
+		}
+	}
+
+	if(SlotIndexMap.Num() != Slots.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: Equipment slot ids need to be unique"), *GetName());
+	}
+}
+
+const FAGREquipmentAcceptance& UDA_AGR_EquipmentSchema::GetAcceptance() const
+{
+	if(!Acceptance.IsBuilt())
+	{
+		Acceptance.Build(Slots);
+	}
+
+	return Acceptance;
+}
@@ -0,0 +1,372 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#include "Subsystems/AGR_AnimMasterSubsystem.h"
+#include "Async/ParallelFor.h"
+#include "Components/AGRAnimMasterComponent.h"
+#include "Components/AGR_SoundMaster.h"
+#include "Data/AGRAnimSettings.h"
+#include "Data/AGRLibrary.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PlayerController.h"
+#include "SignificanceManager.h"
+
+/* Below this many traces the worker thread dispatch costs more than it saves */
+static constexpr int32 AGRMinAimTracesPerWorker = 8;
+
+static const FName AGRSignificanceTag = TEXT("AGRCharacter");
+
+/* Significance is the negated distance to the viewer, so the closest viewer wins. May run on worker threads. */
+static float CalculateAGRSignificance(USignificanceManager::FManagedObjectInfo* ObjectInfo, const FTransform& Viewpoint)
+{
+	const AActor* Actor = Cast<AActor>(ObjectInfo->GetObject());
+	if(!IsValid(Actor))
+	{
+		return -MAX_FLT;
+	}
+
+	// The player's own character always runs at full detail
+	const APawn* Pawn = Cast<APawn>(Actor);
+	if(IsValid(Pawn) && Pawn->IsLocallyControlled() && Pawn->IsPlayerControlled())
+	{
+		return 0.0f;
+	}
+
+	float Distance = FVector::Dist(Viewpoint.GetLocation(), Actor->GetActorLocation());
+	if(Actor->GetNetMode() != NM_DedicatedServer && !Actor->WasRecentlyRendered(0.2f))
+	{
+		Distance *= GetDefault<UAGRAnimSettings>()->NotRenderedDistanceScale;
+	}
+
+	return -Distance;
+}
+
+static void PostAGRSignificance(USignificanceManager::FManagedObjectInfo* ObjectInfo, const float OldSignificance, const float Significance, const bool bFinal)
+{
+	const UAGRAnimSettings* Settings = GetDefault<UAGRAnimSettings>();
+	const int32 OldBucket = Settings->GetSignificanceBucket(-OldSignificance);
+	const int32 NewBucket = Settings->GetSignificanceBucket(-Significance);
+	if(OldBucket == NewBucket)
+	{
+		return;
+	}
+
+	AActor* Actor = Cast<AActor>(ObjectInfo->GetObject());
+	const FAGRSignificanceBucket* Bucket = Settings->SignificanceBuckets.IsValidIndex(NewBucket) ? &Settings->SignificanceBuckets[NewBucket] : nullptr;
+
+	if(UAGRAnimMasterComponent* AnimMaster = UAGRLibrary::GetAnimationMaster(Actor))
+	{
+		AnimMaster->ApplySignificanceBucket(Bucket);
+	}
+
+	if(UAGR_SoundMaster* SoundMaster = UAGRLibrary::GetSound(Actor))
+	{
+		SoundMaster->ApplySignificanceBucket(Bucket);
+	}
+}
+
+void FAGRManagedAnimMasterData::Add()
+{
+	TimeUntilTick.Add(0.0f);
+	bTickEnabled.Add(true);
+	bTurnInPlace.Add(false);
+	AimYaw.Add(0.0f);
+	ActorYaw.Add(0.0f);
+	Speed.Add(0.0f);
+	TurnStartAngle.Add(0.0f);
+	TurnStopTolerance.Add(0.0f);
+	TurnDecision.Add(-1);
+}
+
+void FAGRManagedAnimMasterData::RemoveAtSwap(const int32 Index)
+{
+	TimeUntilTick.RemoveAtSwap(Index, 1, false);
+	bTickEnabled.RemoveAtSwap(Index, 1, false);
+	bTurnInPlace.RemoveAtSwap(Index, 1, false);
+	AimYaw.RemoveAtSwap(Index, 1, false);
+	ActorYaw.RemoveAtSwap(Index, 1, false);
+	Speed.RemoveAtSwap(Index, 1, false);
+	TurnStartAngle.RemoveAtSwap(Index, 1, false);
+	TurnStopTolerance.RemoveAtSwap(Index, 1, false);
+	TurnDecision.RemoveAtSwap(Index, 1, false);
+}
+
+void UAGR_AnimMasterSubsystem::Deinitialize()
+{
+	AimTraceRequests.Empty();
+	SignificanceRefCounts.Empty();
+
+	for(UAGRAnimMasterComponent* Component : ManagedAnimMasters)
+	{
+		if(IsValid(Component))
+		{
+			Component->ManagedTickIndex = INDEX_NONE;
+		}
+	}
+	ManagedAnimMasters.Empty();
+	ManagedData = FAGRManagedAnimMasterData();
+
+	Super::Deinitialize();
+}
+
+TStatId UAGR_AnimMasterSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAGR_AnimMasterSubsystem, STATGROUP_Tickables);
+}
+
+void UAGR_AnimMasterSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Before the batch so batched traces queued by managed components run this frame
+	if(ManagedAnimMasters.Num() > 0)
+	{
+		TickManagedAnimMasters(DeltaTime);
+	}
+
+	if(AimTraceRequests.Num() > 0)
+	{
+		RunAimTraces();
+	}
+
+	if(SignificanceRefCounts.Num() > 0 && GetDefault<UAGRAnimSettings>()->bUpdateSignificanceManager)
+	{
+		UpdateSignificanceManager();
+	}
+}
+
+void UAGR_AnimMasterSubsystem::RequestAimTrace(
+	UAGRAnimMasterComponent* Component,
+	const FVector& Start,
+	const FVector& End,
+	const ECollisionChannel TraceChannel,
+	const FCollisionQueryParams& QueryParams,
+	const bool bUpdateAimOffset)
+{
+	FAGRAimTraceRequest& Request = AimTraceRequests.AddDefaulted_GetRef();
+	Request.Component = Component;
+	Request.Start = Start;
+	Request.End = End;
+	Request.TraceChannel = TraceChannel;
+	Request.QueryParams = QueryParams;
+	Request.bUpdateAimOffset = bUpdateAimOffset;
+}
+
+void UAGR_AnimMasterSubsystem::RunAimTraces()
+{
+	const UWorld* World = GetWorld();
+	if(!IsValid(World))
+	{
+		AimTraceRequests.Reset();
+		return;
+	}
+
+	// Scene queries only read the physics scene, which is not written to while tickables run
+	const int32 NumRequests = AimTraceRequests.Num();
+	const int32 NumBatches = FMath::Max(1, NumRequests / AGRMinAimTracesPerWorker);
+	ParallelFor(NumBatches, [this, World, NumRequests, NumBatches](const int32 BatchIndex)
+	{
+		const int32 First = NumRequests * BatchIndex / NumBatches;
+		const int32 Last = NumRequests * (BatchIndex + 1) / NumBatches;
+		for(int32 Index = First; Index < Last; Index++)
+		{
+			FAGRAimTraceRequest& Request = AimTraceRequests[Index];
+			Request.bHit = World->LineTraceSingleByChannel(
+				Request.HitResult,
+				Request.Start,
+				Request.End,
+				Request.TraceChannel,
+				Request.QueryParams);
+		}
+	}, NumBatches == 1);
+
+	for(const FAGRAimTraceRequest& Request : AimTraceRequests)
+	{
+		if(UAGRAnimMasterComponent* Component = Request.Component.Get())
+		{
+			Component->ApplyBatchedAimTrace(Request);
+		}
+	}
+
+	AimTraceRequests.Reset();
+}
+
+void UAGR_AnimMasterSubsystem::RegisterSignificance(AActor* Actor)
+{
+	if(!IsValid(Actor) || !GetDefault<UAGRAnimSettings>()->bUseSignificance)
+	{
+		return;
+	}
+
+	USignificanceManager* SignificanceManager = USignificanceManager::Get(GetWorld());
+	if(!IsValid(SignificanceManager))
+	{
+		return;
+	}
+
+	int32& RefCount = SignificanceRefCounts.FindOrAdd(Actor);
+	if(RefCount++ == 0)
+	{
+		SignificanceManager->RegisterObject(
+			Actor,
+			AGRSignificanceTag,
+			&CalculateAGRSignificance,
+			USignificanceManager::EPostSignificanceType::Sequential,
+			&PostAGRSignificance);
+	}
+}
+
+void UAGR_AnimMasterSubsystem::UnregisterSignificance(AActor* Actor)
+{
+	int32* RefCount = SignificanceRefCounts.Find(Actor);
+	if(RefCount == nullptr || --(*RefCount) > 0)
+	{
+		return;
+	}
+
+	SignificanceRefCounts.Remove(Actor);
+
+	if(USignificanceManager* SignificanceManager = USignificanceManager::Get(GetWorld()))
+	{
+		SignificanceManager->UnregisterObject(Actor);
+	}
+}
+
+void UAGR_AnimMasterSubsystem::UpdateSignificanceManager()
+{
+	UWorld* World = GetWorld();
+	USignificanceManager* SignificanceManager = USignificanceManager::Get(World);
+	if(!IsValid(SignificanceManager))
+	{
+		return;
+	}
+
+	// On servers these are the views of all connected players, on clients the local (splitscreen) players
+	Viewpoints.Reset();
+	for(FConstPlayerControllerIterator Iterator = World->GetPlayerControllerIterator(); Iterator; ++Iterator)
+	{
+		const APlayerController* PlayerController = Iterator->Get();
+		if(IsValid(PlayerController))
+		{
+			FVector Location;
+			FRotator Rotation;
+			PlayerController->GetPlayerViewPoint(Location, Rotation);
+			Viewpoints.Emplace(Rotation, Location);
+		}
+	}
+
+	SignificanceManager->Update(Viewpoints);
+}
+
+void UAGR_AnimMasterSubsystem::RegisterManagedTick(UAGRAnimMasterComponent* Component)
+{
+	if(!IsValid(Component) || Component->ManagedTickIndex != INDEX_NONE)
+	{
+		return;
+	}
+
+	Component->ManagedTickIndex = ManagedAnimMasters.Add(Component);
+	ManagedData.Add();
+
+	ManagedData.TimeUntilTick[Component->ManagedTickIndex] = Component->PrimaryComponentTick.TickInterval;
+}
+
+void UAGR_AnimMasterSubsystem::UnregisterManagedTick(UAGRAnimMasterComponent* Component)
+{
+	if(!IsValid(Component) || !ManagedAnimMasters.IsValidIndex(Component->ManagedTickIndex))
+	{
+		return;
+	}
+
+	const int32 Index = Component->ManagedTickIndex;
+	ManagedAnimMasters.RemoveAtSwap(Index, 1, false);
+	ManagedData.RemoveAtSwap(Index);
+	Component->ManagedTickIndex = INDEX_NONE;
+
+	if(ManagedAnimMasters.IsValidIndex(Index) && IsValid(ManagedAnimMasters[Index]))
+	{
+		ManagedAnimMasters[Index]->ManagedTickIndex = Index;
+	}
+}
+
+void UAGR_AnimMasterSubsystem::SetManagedTickState(const UAGRAnimMasterComponent* Component, const bool bEnabled)
+{
+	const int32 Index = IsValid(Component) ? Component->ManagedTickIndex : INDEX_NONE;
+	if(!ManagedAnimMasters.IsValidIndex(Index))
+	{
+		return;
+	}
+
+	ManagedData.bTickEnabled[Index] = bEnabled;
+}
+
+void UAGR_AnimMasterSubsystem::TickManagedAnimMasters(const float DeltaTime)
+{
+	const int32 Num = ManagedAnimMasters.Num();
+
+	// Gather: aim (traces, sockets) per component, then the turn in place inputs into flat arrays
+	for(int32 Index = 0; Index < Num; Index++)
+	{
+		ManagedData.bTurnInPlace[Index] = false;
+
+		ManagedData.TimeUntilTick[Index] -= DeltaTime;
+		if(!ManagedData.bTickEnabled[Index] || ManagedData.TimeUntilTick[Index] > 0.0f)
+		{
+			continue;
+		}
+
+		UAGRAnimMasterComponent* Component = ManagedAnimMasters[Index];
+		if(!IsValid(Component) || !IsValid(Component->OwningCharacter) || !IsValid(Component->OwnerMovementComponent))
+		{
+			continue;
+		}
+
+		// Read every time, SetComponentTickInterval only writes the component's own tick function
+		ManagedData.TimeUntilTick[Index] = Component->PrimaryComponentTick.TickInterval;
+
+		Component->SignificantAimTick();
+
+		if(Component->RotationMethod == ERotationMethod::DesiredAtAngle)
+		{
+			const ACharacter* Character = Component->OwningCharacter;
+			ManagedData.bTurnInPlace[Index] = true;
+			ManagedData.AimYaw[Index] = Component->AimOffset.Yaw;
+			ManagedData.ActorYaw[Index] = Character->GetActorRotation().Yaw;
+			ManagedData.Speed[Index] = Character->GetVelocity().Size();
+			ManagedData.TurnStartAngle[Index] = Component->TurnStartAngle;
+			ManagedData.TurnStopTolerance[Index] = FMath::Clamp(Component->TurnStopTolerance, 1.0f, 90.0f);
+		}
+	}
+
+	// Turn in place decisions for all components at once, same rules as UAGRAnimMasterComponent::TurnInPlaceTick.
+	// Branch free so the compiler can vectorize it.
+	{
+		const bool* bTurnInPlace = ManagedData.bTurnInPlace.GetData();
+		const float* AimYaw = ManagedData.AimYaw.GetData();
+		const float* ActorYaw = ManagedData.ActorYaw.GetData();
+		const float* Speed = ManagedData.Speed.GetData();
+		const float* TurnStartAngle = ManagedData.TurnStartAngle.GetData();
+		const float* TurnStopTolerance = ManagedData.TurnStopTolerance.GetData();
+		int8* TurnDecision = ManagedData.TurnDecision.GetData();
+
+		for(int32 Index = 0; Index < Num; Index++)
+		{
+			const float RawDelta = AimYaw[Index] - ActorYaw[Index];
+			const float AbsoluteDelta = FMath::Abs(RawDelta - 360.0f * FMath::RoundToFloat(RawDelta / 360.0f));
+
+			const bool bStart = AbsoluteDelta > TurnStartAngle[Index] || Speed[Index] > 25.0f;
+			const bool bStop = AbsoluteDelta <= TurnStopTolerance[Index];
+			const int8 Decision = bStart ? 1 : (bStop ? 0 : -1);
+			TurnDecision[Index] = bTurnInPlace[Index] ? Decision : -1;
+		}
+	}
+
+	// Scatter
+	for(int32 Index = 0; Index < Num; Index++)
+	{
+		const int8 Decision = ManagedData.TurnDecision[Index];
+		if(Decision >= 0)
+		{
+			ManagedAnimMasters[Index]->OwnerMovementComponent->bUseControllerDesiredRotation = Decision == 1;
+		}
+	}
+}
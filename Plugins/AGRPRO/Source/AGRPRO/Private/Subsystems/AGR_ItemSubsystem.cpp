@@ -0,0 +1,543 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#include "Subsystems/AGR_ItemSubsystem.h"
+#include "Components/AGR_ItemComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Data/AGRItemSettings.h"
+#include "Data/AGRLibrary.h"
+
+void UAGR_ItemSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	CellSize = FMath::Max(50.0f, GetDefault<UAGRItemSettings>()->GridCellSize);
+}
+
+void UAGR_ItemSubsystem::Deinitialize()
+{
+	for(const FAGRDroppedItemEntry& Entry : DroppedItems)
+	{
+		if(UAGR_ItemComponent* ItemComponent = Entry.ItemComponent.Get())
+		{
+			ItemComponent->DroppedItemIndex = INDEX_NONE;
+		}
+	}
+
+	DroppedItems.Empty();
+	Cells.Empty();
+	PendingDespawn.Empty();
+	PendingDespawnSet.Empty();
+
+	Super::Deinitialize();
+}
+
+TStatId UAGR_ItemSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UAGR_ItemSubsystem, STATGROUP_Tickables);
+}
+
+void UAGR_ItemSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const UAGRItemSettings* Settings = GetDefault<UAGRItemSettings>();
+	if(!Settings->bManageDroppedItems || DroppedItems.Num() == 0)
+	{
+		return;
+	}
+
+	const UWorld* World = GetWorld();
+	if(!IsValid(World) || World->GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	const float WorldTime = World->GetTimeSeconds();
+	const int32 Budget = FMath::Min(FMath::Max(1, Settings->MaxItemsProcessedPerFrame), DroppedItems.Num());
+	for(int32 i = 0; i < Budget; ++i)
+	{
+		if(ProcessCursor >= DroppedItems.Num())
+		{
+			ProcessCursor = 0;
+		}
+
+		ProcessEntry(ProcessCursor++, WorldTime);
+	}
+
+	/* Destroying removes the entries from the grid (EndPlay) */
+	for(UAGR_ItemComponent* ItemComponent : PendingDespawn)
+	{
+		AActor* ItemActor = IsValid(ItemComponent) ? ItemComponent->GetOwner() : nullptr;
+		if(IsValid(ItemActor))
+		{
+			ItemActor->Destroy();
+		}
+	}
+
+	PendingDespawn.Reset();
+	PendingDespawnSet.Reset();
+}
+
+void UAGR_ItemSubsystem::ProcessEntry(const int32 EntryIndex, const float WorldTime)
+{
+	FAGRDroppedItemEntry& Entry = DroppedItems[EntryIndex];
+
+	UAGR_ItemComponent* ItemComponent = Entry.ItemComponent.Get();
+	if(ItemComponent == nullptr || !Entry.bDropped || IsPendingDespawn(ItemComponent))
+	{
+		return;
+	}
+
+	AActor* ItemActor = ItemComponent->GetOwner();
+	if(!IsValid(ItemActor))
+	{
+		return;
+	}
+
+	const UAGRItemSettings* Settings = GetDefault<UAGRItemSettings>();
+	const bool bProtected = ItemComponent->DespawnPriority >= Settings->ProtectedDespawnPriority;
+
+	/* Too old */
+	if(!bProtected && Settings->MaxDroppedItemAge > 0.0f && WorldTime - Entry.DropTime > Settings->MaxDroppedItemAge)
+	{
+		Despawn(ItemComponent);
+		return;
+	}
+
+	SettleEntry(Entry, Cast<UPrimitiveComponent>(ItemActor->GetRootComponent()), WorldTime);
+
+	/* Only merge items at rest, flying stacks would teleport into each other */
+	if(Settings->bMergeStackables && ItemComponent->bStackable && Entry.bSettled)
+	{
+		MergeStacks(Entry);
+	}
+
+	if(Settings->MaxItemsPerCell > 0)
+	{
+		EnforceCellCap(Entry.Cell);
+	}
+}
+
+void UAGR_ItemSubsystem::SettleEntry(FAGRDroppedItemEntry& Entry, UPrimitiveComponent* PrimitiveComponent, const float WorldTime)
+{
+	if(!IsValid(PrimitiveComponent) || !PrimitiveComponent->IsSimulatingPhysics() || !PrimitiveComponent->RigidBodyIsAwake())
+	{
+		Entry.bSettled = true;
+		return;
+	}
+
+	/* Still moving: keep the index up to date and force sleep once it is slow enough */
+	Entry.bSettled = false;
+	RegisterDroppedItem(Entry.ItemComponent.Get());
+
+	const UAGRItemSettings* Settings = GetDefault<UAGRItemSettings>();
+	if(WorldTime - Entry.DropTime < Settings->SettleTime)
+	{
+		return;
+	}
+
+	if(PrimitiveComponent->GetPhysicsLinearVelocity().SizeSquared() <= FMath::Square(Settings->SettleSpeed))
+	{
+		PrimitiveComponent->PutRigidBodyToSleep();
+		Entry.bSettled = true;
+	}
+}
+
+void UAGR_ItemSubsystem::MergeStacks(const FAGRDroppedItemEntry& Entry)
+{
+	UAGR_ItemComponent* TargetItemComponent = Entry.ItemComponent.Get();
+	if(TargetItemComponent == nullptr || TargetItemComponent->CurrentStack >= TargetItemComponent->MaxStack)
+	{
+		return;
+	}
+
+	const UClass* ItemClass = TargetItemComponent->GetOwner()->GetClass();
+	const float MergeRadius = GetDefault<UAGRItemSettings>()->MergeRadius;
+	const float MergeRadiusSquared = FMath::Square(MergeRadius);
+
+	ForEachEntryNear(Entry.Location, MergeRadius, [&](const FAGRDroppedItemEntry& OtherEntry)
+	{
+		if(TargetItemComponent->CurrentStack >= TargetItemComponent->MaxStack || !OtherEntry.bSettled || !OtherEntry.bDropped)
+		{
+			return;
+		}
+
+		UAGR_ItemComponent* SourceItemComponent = OtherEntry.ItemComponent.Get();
+		if(SourceItemComponent == nullptr
+			|| SourceItemComponent == TargetItemComponent
+			|| !SourceItemComponent->bStackable
+			|| IsPendingDespawn(SourceItemComponent))
+		{
+			return;
+		}
+
+		/* Identical items only */
+		const AActor* SourceItemActor = SourceItemComponent->GetOwner();
+		if(!IsValid(SourceItemActor) || SourceItemActor->GetClass() != ItemClass)
+		{
+			return;
+		}
+
+		if(FVector::DistSquared(Entry.Location, OtherEntry.Location) > MergeRadiusSquared)
+		{
+			return;
+		}
+
+		const int32 StacksToMove = FMath::Min(
+			SourceItemComponent->CurrentStack,
+			TargetItemComponent->MaxStack - TargetItemComponent->CurrentStack);
+		if(StacksToMove <= 0)
+		{
+			return;
+		}
+
+		TargetItemComponent->CurrentStack += StacksToMove;
+		SourceItemComponent->CurrentStack -= StacksToMove;
+
+		if(SourceItemComponent->CurrentStack <= 0)
+		{
+			Despawn(SourceItemComponent);
+		}
+	});
+}
+
+void UAGR_ItemSubsystem::EnforceCellCap(const FIntPoint& Cell)
+{
+	const UAGRItemSettings* Settings = GetDefault<UAGRItemSettings>();
+
+	const TArray<int32>* CellEntries = Cells.Find(Cell);
+	if(CellEntries == nullptr || CellEntries->Num() <= Settings->MaxItemsPerCell)
+	{
+		return;
+	}
+
+	int32 NumAlive = 0;
+	TArray<int32, TInlineAllocator<32>> Candidates;
+	for(const int32 EntryIndex : *CellEntries)
+	{
+		const UAGR_ItemComponent* ItemComponent = DroppedItems[EntryIndex].ItemComponent.Get();
+		if(ItemComponent == nullptr || !DroppedItems[EntryIndex].bDropped || IsPendingDespawn(ItemComponent))
+		{
+			continue;
+		}
+
+		++NumAlive;
+		if(ItemComponent->DespawnPriority < Settings->ProtectedDespawnPriority)
+		{
+			Candidates.Add(EntryIndex);
+		}
+	}
+
+	const int32 NumToDespawn = FMath::Min(NumAlive - Settings->MaxItemsPerCell, Candidates.Num());
+	if(NumToDespawn <= 0)
+	{
+		return;
+	}
+
+	/* Lowest priority first, oldest first among equal priorities */
+	Candidates.Sort([this](const int32 A, const int32 B)
+	{
+		const FAGRDroppedItemEntry& EntryA = DroppedItems[A];
+		const FAGRDroppedItemEntry& EntryB = DroppedItems[B];
+		const int32 PriorityA = EntryA.ItemComponent->DespawnPriority;
+		const int32 PriorityB = EntryB.ItemComponent->DespawnPriority;
+		return PriorityA != PriorityB ? PriorityA < PriorityB : EntryA.DropTime < EntryB.DropTime;
+	});
+
+	for(int32 i = 0; i < NumToDespawn; ++i)
+	{
+		Despawn(DroppedItems[Candidates[i]].ItemComponent.Get());
+	}
+}
+
+void UAGR_ItemSubsystem::Despawn(UAGR_ItemComponent* ItemComponent)
+{
+	bool bAlreadyPending = false;
+	if(ItemComponent != nullptr)
+	{
+		PendingDespawnSet.Add(ItemComponent, &bAlreadyPending);
+		if(!bAlreadyPending)
+		{
+			PendingDespawn.Add(ItemComponent);
+		}
+	}
+}
+
+bool UAGR_ItemSubsystem::IsPendingDespawn(const UAGR_ItemComponent* ItemComponent) const
+{
+	return PendingDespawnSet.Contains(ItemComponent);
+}
+
+FIntPoint UAGR_ItemSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(
+		FMath::FloorToInt(Location.X / CellSize),
+		FMath::FloorToInt(Location.Y / CellSize));
+}
+
+void UAGR_ItemSubsystem::AddToCell(const FIntPoint& Cell, const int32 EntryIndex)
+{
+	Cells.FindOrAdd(Cell).Add(EntryIndex);
+}
+
+void UAGR_ItemSubsystem::RemoveFromCell(const FIntPoint& Cell, const int32 EntryIndex)
+{
+	TArray<int32>* CellEntries = Cells.Find(Cell);
+	if(CellEntries == nullptr)
+	{
+		return;
+	}
+
+	CellEntries->RemoveSingleSwap(EntryIndex, false);
+	if(CellEntries->Num() == 0)
+	{
+		Cells.Remove(Cell);
+	}
+}
+
+void UAGR_ItemSubsystem::RegisterDroppedItem(UAGR_ItemComponent* ItemComponent, const bool bDropped)
+{
+	if(!IsValid(ItemComponent) || !IsValid(ItemComponent->GetOwner()))
+	{
+		return;
+	}
+
+	const FVector Location = ItemComponent->GetOwner()->GetActorLocation();
+	const FIntPoint Cell = GetCell(Location);
+
+	/* Already indexed -> only refresh location */
+	const int32 ExistingIndex = ItemComponent->DroppedItemIndex;
+	if(DroppedItems.IsValidIndex(ExistingIndex) && DroppedItems[ExistingIndex].ItemComponent == ItemComponent)
+	{
+		FAGRDroppedItemEntry& Entry = DroppedItems[ExistingIndex];
+		Entry.Location = Location;
+		if(bDropped && !Entry.bDropped)
+		{
+			Entry.bDropped = true;
+			Entry.bSettled = false;
+			Entry.DropTime = GetWorld()->GetTimeSeconds();
+		}
+		if(Entry.Cell != Cell)
+		{
+			RemoveFromCell(Entry.Cell, ExistingIndex);
+			AddToCell(Cell, ExistingIndex);
+			Entry.Cell = Cell;
+		}
+
+		return;
+	}
+
+	FAGRDroppedItemEntry NewEntry;
+	NewEntry.ItemComponent = ItemComponent;
+	NewEntry.Location = Location;
+	NewEntry.Cell = Cell;
+	NewEntry.DropTime = GetWorld()->GetTimeSeconds();
+	NewEntry.bDropped = bDropped;
+
+	const int32 NewIndex = DroppedItems.Add(NewEntry);
+	AddToCell(Cell, NewIndex);
+	ItemComponent->DroppedItemIndex = NewIndex;
+}
+
+void UAGR_ItemSubsystem::UnregisterDroppedItem(UAGR_ItemComponent* ItemComponent)
+{
+	if(ItemComponent == nullptr)
+	{
+		return;
+	}
+
+	const int32 EntryIndex = ItemComponent->DroppedItemIndex;
+	ItemComponent->DroppedItemIndex = INDEX_NONE;
+
+	if(!DroppedItems.IsValidIndex(EntryIndex) || DroppedItems[EntryIndex].ItemComponent != ItemComponent)
+	{
+		return;
+	}
+
+	RemoveFromCell(DroppedItems[EntryIndex].Cell, EntryIndex);
+
+	/* Swap last entry into the freed index so the array stays dense */
+	const int32 LastIndex = DroppedItems.Num() - 1;
+	if(EntryIndex != LastIndex)
+	{
+		const FAGRDroppedItemEntry& LastEntry = DroppedItems[LastIndex];
+		if(TArray<int32>* CellEntries = Cells.Find(LastEntry.Cell))
+		{
+			const int32 Position = CellEntries->Find(LastIndex);
+			if(Position != INDEX_NONE)
+			{
+				(*CellEntries)[Position] = EntryIndex;
+			}
+		}
+
+		if(UAGR_ItemComponent* LastItemComponent = LastEntry.ItemComponent.Get())
+		{
+			LastItemComponent->DroppedItemIndex = EntryIndex;
+		}
+	}
+
+	DroppedItems.RemoveAtSwap(EntryIndex, 1, false);
+}
+
+void UAGR_ItemSubsystem::RegisterItemId(UAGR_ItemComponent* ItemComponent, const FGuid& ItemId)
+{
+	if(IsValid(ItemComponent) && ItemId.IsValid())
+	{
+		ItemsById.Add(ItemId, ItemComponent);
+	}
+}
+
+void UAGR_ItemSubsystem::UnregisterItemId(const UAGR_ItemComponent* ItemComponent, const FGuid& ItemId)
+{
+	// Only remove our own entry, a copied item may have registered the same id since
+	const TWeakObjectPtr<UAGR_ItemComponent>* RegisteredItem = ItemsById.Find(ItemId);
+	if(RegisteredItem != nullptr && (RegisteredItem->Get() == ItemComponent || !RegisteredItem->IsValid()))
+	{
+		ItemsById.Remove(ItemId);
+	}
+}
+
+UAGR_ItemComponent* UAGR_ItemSubsystem::FindItemComponentById(const FGuid& ItemId) const
+{
+	const TWeakObjectPtr<UAGR_ItemComponent>* RegisteredItem = ItemsById.Find(ItemId);
+	return RegisteredItem != nullptr ? RegisteredItem->Get() : nullptr;
+}
+
+bool UAGR_ItemSubsystem::FindItemById(const FGuid& ItemId, AActor*& OutItem) const
+{
+	const UAGR_ItemComponent* ItemComponent = FindItemComponentById(ItemId);
+	if(!IsValid(ItemComponent))
+	{
+		return false;
+	}
+
+	OutItem = ItemComponent->GetOwner();
+	return IsValid(OutItem);
+}
+
+void UAGR_ItemSubsystem::RefreshDroppedItem(AActor* Item)
+{
+	UAGR_ItemComponent* ItemComponent = UAGRLibrary::GetItemComponent(Item);
+	if(!IsValid(ItemComponent) || ItemComponent->DroppedItemIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	RegisterDroppedItem(ItemComponent);
+}
+
+template<typename VisitorType>
+void UAGR_ItemSubsystem::ForEachEntryNear(const FVector& Origin, const float Radius, VisitorType&& Visitor) const
+{
+	const FIntPoint MinCell = GetCell(Origin - FVector(Radius));
+	const FIntPoint MaxCell = GetCell(Origin + FVector(Radius));
+	const int64 CellsInBounds = static_cast<int64>(MaxCell.X - MinCell.X + 1) * (MaxCell.Y - MinCell.Y + 1);
+
+	/* Huge query bounds over a sparse grid: walking the occupied cells is cheaper than walking the bounds */
+	if(CellsInBounds > Cells.Num())
+	{
+		for(const TPair<FIntPoint, TArray<int32>>& CellPair : Cells)
+		{
+			const FIntPoint& Cell = CellPair.Key;
+			if(Cell.X < MinCell.X || Cell.X > MaxCell.X || Cell.Y < MinCell.Y || Cell.Y > MaxCell.Y)
+			{
+				continue;
+			}
+
+			for(const int32 EntryIndex : CellPair.Value)
+			{
+				Visitor(DroppedItems[EntryIndex]);
+			}
+		}
+
+		return;
+	}
+
+	for(int32 X = MinCell.X; X <= MaxCell.X; ++X)
+	{
+		for(int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			const TArray<int32>* CellEntries = Cells.Find(FIntPoint(X, Y));
+			if(CellEntries == nullptr)
+			{
+				continue;
+			}
+
+			for(const int32 EntryIndex : *CellEntries)
+			{
+				Visitor(DroppedItems[EntryIndex]);
+			}
+		}
+	}
+}
+
+bool UAGR_ItemSubsystem::QueryItemsInRadius(const FVector Origin, const float Radius, TArray<AActor*>& OutItems) const
+{
+	OutItems.Reset();
+
+	if(Radius <= 0.0f)
+	{
+		return false;
+	}
+
+	const float RadiusSquared = FMath::Square(Radius);
+	ForEachEntryNear(Origin, Radius, [&](const FAGRDroppedItemEntry& Entry)
+	{
+		if(FVector::DistSquared(Origin, Entry.Location) > RadiusSquared)
+		{
+			return;
+		}
+
+		const UAGR_ItemComponent* ItemComponent = Entry.ItemComponent.Get();
+		if(ItemComponent != nullptr && IsValid(ItemComponent->GetOwner()))
+		{
+			OutItems.Add(ItemComponent->GetOwner());
+		}
+	});
+
+	return OutItems.Num() > 0;
+}
+
+bool UAGR_ItemSubsystem::QueryItemsInCone(
+	const FVector Origin,
+	const FVector Direction,
+	const float Range,
+	const float HalfAngle,
+	TArray<AActor*>& OutItems) const
+{
+	OutItems.Reset();
+
+	const FVector Forward = Direction.GetSafeNormal();
+	if(Range <= 0.0f || Forward.IsZero())
+	{
+		return false;
+	}
+
+	const float RangeSquared = FMath::Square(Range);
+	const float CosHalfAngle = FMath::Cos(FMath::DegreesToRadians(FMath::Clamp(HalfAngle, 0.0f, 180.0f)));
+
+	ForEachEntryNear(Origin, Range, [&](const FAGRDroppedItemEntry& Entry)
+	{
+		const FVector ToItem = Entry.Location - Origin;
+		const float DistanceSquared = ToItem.SizeSquared();
+		if(DistanceSquared > RangeSquared)
+		{
+			return;
+		}
+
+		/* Item exactly at the origin is always inside the cone */
+		if(DistanceSquared > KINDA_SMALL_NUMBER
+			&& FVector::DotProduct(ToItem, Forward) < CosHalfAngle * FMath::Sqrt(DistanceSquared))
+		{
+			return;
+		}
+
+		const UAGR_ItemComponent* ItemComponent = Entry.ItemComponent.Get();
+		if(ItemComponent != nullptr && IsValid(ItemComponent->GetOwner()))
+		{
+			OutItems.Add(ItemComponent->GetOwner());
+		}
+	});
+
+	return OutItems.Num() > 0;
+}
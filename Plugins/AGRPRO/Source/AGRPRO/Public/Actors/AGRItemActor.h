@@ -0,0 +1,28 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Data/AGRComponentTableProvider.h"
+#include "GameFramework/Actor.h"
+
+#include "AGRItemActor.generated.h"
+
+/**
+ * Optional base class for item actors.
+ *
+ * Items work on any actor with an AGR item component. Deriving from this class only speeds up
+ * UAGRLibrary::GetItemComponent, which inventory and equipment loops call for every item.
+ */
+UCLASS(Blueprintable)
+class AGRPRO_API AAGRItemActor : public AActor, public IAGRComponentTableProvider
+{
+	GENERATED_BODY()
+
+private:
+	FAGRComponentTable AGRComponentTable;
+
+public:
+	AAGRItemActor();
+
+	virtual FAGRComponentTable& GetAGRComponentTable() override { return AGRComponentTable; }
+};
@@ -4,11 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "Components/AGRAnimMasterComponent.h"
+#include "Data/AGRComponentTableProvider.h"
 #include "GameFramework/Character.h"
 #include "AGRCharacter.generated.h"
 
 UCLASS(Abstract)
-class AGRPRO_API AAGRCharacter : public ACharacter
+class AGRPRO_API AAGRCharacter : public ACharacter, public IAGRComponentTableProvider
 {
 	GENERATED_BODY()
 
@@ -16,16 +17,17 @@ private:
 	UPROPERTY(Category = "AGR PRO", VisibleAnywhere, BlueprintReadOnly, meta=(AllowPrivateAccess = "true"))
 	UAGRAnimMasterComponent* AGRAnimMasterComponent;
 
+	FAGRComponentTable AGRComponentTable;
+
 public:
 	// Sets default values for this character's properties
 	AAGRCharacter();
 
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-
 	// Called to bind functionality to input
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
+	virtual FAGRComponentTable& GetAGRComponentTable() override { return AGRComponentTable; }
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
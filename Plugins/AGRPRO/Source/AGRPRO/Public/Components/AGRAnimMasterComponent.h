@@ -3,9 +3,11 @@
 #pragma once
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "Data/AGRTraceContext.h"
 #include "Data/AGRTypes.h"
 #include "GameplayTags.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "WorldCollision.h"
 
 #if WITH_EDITOR
 #include "UI/AGRDebuggerController.h"
@@ -13,6 +15,9 @@
 
 #include "AGRAnimMasterComponent.generated.h"
 
+struct FAGRAimTraceRequest;
+struct FAGRSignificanceBucket;
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnFirstPerson, bool, bIsFirstPersonView);
 
 UCLASS(BlueprintType, Blueprintable, ClassGroup=("AGR"), meta=(BlueprintSpawnableComponent) )
@@ -21,10 +26,10 @@ class AGRPRO_API UAGRAnimMasterComponent : public UActorComponent
 	GENERATED_BODY()
 
 public:
-	UPROPERTY(BlueprintReadWrite, Replicated, EditAnywhere, Category = "AGR|Setup")
+	UPROPERTY(BlueprintReadWrite, ReplicatedUsing = OnRep_SetupState, EditAnywhere, Category = "AGR|Setup")
 	FGameplayTag BasePose;
 
-	UPROPERTY(BlueprintReadWrite, Replicated, EditAnywhere, Category = "AGR|Setup")
+	UPROPERTY(BlueprintReadWrite, ReplicatedUsing = OnRep_SetupState, EditAnywhere, Category = "AGR|Setup")
 	FGameplayTag OverlayPose;
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "AGR|Runtime")
@@ -45,16 +50,16 @@ public:
 	UPROPERTY(BlueprintReadWrite, ReplicatedUsing = OnRep_RotationSpeed, EditDefaultsOnly, Category = "AGR|Setup")
 	float RotationSpeed = 360.0f;
 
-	UPROPERTY(BlueprintReadWrite, Replicated, EditDefaultsOnly, Category = "AGR|Setup")
+	UPROPERTY(BlueprintReadWrite, ReplicatedUsing = OnRep_SetupState, EditDefaultsOnly, Category = "AGR|Setup")
 	float TurnStartAngle = 90.0f;
 
-	UPROPERTY(BlueprintReadWrite, Replicated, EditDefaultsOnly, Category = "AGR|Setup")
+	UPROPERTY(BlueprintReadWrite, ReplicatedUsing = OnRep_SetupState, EditDefaultsOnly, Category = "AGR|Setup")
 	float TurnStopTolerance = 1.0f;
 
-	UPROPERTY(BlueprintReadWrite, Replicated, EditDefaultsOnly, Category = "AGR|Setup")
+	UPROPERTY(BlueprintReadWrite, ReplicatedUsing = OnRep_SetupState, EditDefaultsOnly, Category = "AGR|Setup")
 	EAimOffsets AimOffsetType = EAimOffsets::NONE;
 
-	UPROPERTY(BlueprintReadWrite, Replicated, EditDefaultsOnly, Category = "AGR|Setup")
+	UPROPERTY(BlueprintReadWrite, ReplicatedUsing = OnRep_SetupState, EditDefaultsOnly, Category = "AGR|Setup")
 	EAimOffsetClamp AimOffsetBehavior = EAimOffsetClamp::Nearest;
 
 	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Setup")
@@ -72,6 +77,67 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Debug")
 	TEnumAsByte <ECollisionChannel> TraceChannel = ECollisionChannel::ECC_Visibility;
 
+	/**
+	 * Async traces run alongside the rest of the frame, their result is applied one frame later.
+	 * Batched traces run together with all other batched AnimMasters of the world at the end of the frame.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Setup")
+	EAGRAimTraceMode AimTraceMode = EAGRAimTraceMode::Sync;
+
+	/** How AI controlled characters find their look-at location */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Setup")
+	EAGRAILookAtMode AILookAtMode = EAGRAILookAtMode::Focus;
+
+	/**
+	 * Reuse the last aim trace while the trace origin and direction stay (nearly) the same, the hit object did not move
+	 * and no dynamic object (WorldDynamic, Pawn, PhysicsBody) overlaps the traced ray
+	 */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Setup")
+	bool bCacheAimTrace = true;
+
+	/** Maximum movement (cm) of the trace origin for the cached trace to be reused */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Setup", meta=(ClampMin="0.0", UIMin="0.0", EditCondition="bCacheAimTrace"))
+	float AimTraceCacheDistance = 1.0f;
+
+	/** Maximum rotation (degrees) of the trace direction for the cached trace to be reused */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Setup", meta=(ClampMin="0.0", UIMin="0.0", EditCondition="bCacheAimTrace"))
+	float AimTraceCacheAngle = 0.1f;
+
+	/** Seconds after which the trace is repeated even if nothing moved, picks up static objects entering the ray */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Setup", meta=(ClampMin="0.0", UIMin="0.0", EditCondition="bCacheAimTrace"))
+	float AimTraceMaxCacheAge = 0.2f;
+
+	/** Maximum number of aim updates per second sent by the controlling client. 0 = every tick. */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Network", meta=(ClampMin="0.0", UIMin="0.0"))
+	float AimNetUpdateRate = 20.0f;
+
+	/** Aim offset changes smaller than this (degrees) are not sent */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Network", meta=(ClampMin="0.0", UIMin="0.0"))
+	float AimNetAngleThreshold = 0.5f;
+
+	/** Look-at location changes smaller than this (cm) are not sent */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Network", meta=(ClampMin="0.0", UIMin="0.0"))
+	float LookAtNetDistanceThreshold = 5.0f;
+
+	/**
+	 * Once the aim stopped changing for this long (seconds) the exact resting state is sent one more time. Covers a lost
+	 * last update and changes below the thresholds. 0 = never.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Network", meta=(ClampMin="0.0", UIMin="0.0"))
+	float AimNetRestResendDelay = 0.5f;
+
+	/** Smooth the aim of simulated proxies through a sample buffer instead of applying each update as it arrives */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Network")
+	bool bInterpolateRemoteAim = true;
+
+	/** Seconds remote aim is displayed behind the latest update. Should be above the send interval of the controlling client. */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Network", meta=(ClampMin="0.0", UIMin="0.0", EditCondition="bInterpolateRemoteAim"))
+	float RemoteAimInterpDelay = 0.1f;
+
+	/** Seconds remote aim keeps moving past the latest update when updates stop coming in */
+	UPROPERTY(BlueprintReadWrite, EditDefaultsOnly, Category = "AGR|Network", meta=(ClampMin="0.0", UIMin="0.0", EditCondition="bInterpolateRemoteAim"))
+	float RemoteAimMaxExtrapolation = 0.1f;
+
 	UPROPERTY(BlueprintReadOnly, Category = "AGR|Components")
 	ACharacter* OwningCharacter;
 
@@ -87,6 +153,68 @@ public:
 	#endif
 
 private:
+	/* Aim of the controlling client as seen by simulated proxies */
+	UPROPERTY(ReplicatedUsing = OnRep_NetAimState)
+	FAGRNetAimState NetAimState;
+
+	/* Last state sent by the controlling client, used for the rate and threshold checks */
+	FAGRNetAimState LastSentAimState;
+	float LastAimSendTime = 0.0f;
+	bool bAimStateSent = false;
+	bool bAimRestStateSent = false;
+
+	FAGRTraceContext TraceContext;
+
+	/* Setup last sent to the server by the owning client, see RequestSetupSync. Invalidated when the server sends its own. */
+	FAGRAnimSetupState SentSetupState;
+	bool bSetupStateSent = false;
+	bool bSetupSyncPending = false;
+
+	/* Index in UAGR_AnimMasterSubsystem if ticked by the subsystem, see UAGRAnimSettings::bManageAnimMasterTicks */
+	int32 ManagedTickIndex = INDEX_NONE;
+
+	/* Aim work allowed by the significance bucket, see ShouldRunAimTick */
+	bool bAimSignificant = true;
+	float SignificanceAimInterval = 0.0f;
+	float LastAimTickTime = -MAX_flt;
+
+	/* Async aim trace in flight. Results of older handles are dropped. */
+	FTraceHandle PendingAimTrace;
+	bool bPendingAimTraceUpdatesAimOffset = false;
+	FTraceDelegate AimTraceDelegate;
+
+	/* Last applied aim trace, see bCacheAimTrace */
+	struct FAimTraceCache
+	{
+		bool bValid = false;
+		bool bHit = false;
+		bool bUpdateAimOffset = false;
+		float Time = 0.0f;
+		FVector Start = FVector::ZeroVector;
+		FVector Direction = FVector::ZeroVector;
+		/* Impact point, or the trace end on a miss */
+		FVector End = FVector::ZeroVector;
+		FHitResult HitResult;
+		FTransform HitComponentTransform;
+	};
+
+	FAimTraceCache AimTraceCache;
+
+	/* Received aim of a simulated proxy, stamped with the local receive time */
+	struct FAimSample
+	{
+		float Time = 0.0f;
+		FRotator AimOffset = FRotator::ZeroRotator;
+		FVector LookAtLocation = FVector::ZeroVector;
+	};
+
+	static constexpr int32 AimSampleCapacity = 8;
+
+	/* Ring buffer, AimSampleHead is the slot written next */
+	FAimSample AimSamples[AimSampleCapacity];
+	int32 AimSampleHead = 0;
+	int32 AimSampleCount = 0;
+
 	#if WITH_EDITORONLY_DATA
 	UPROPERTY()
 	UUserWidget* DebugWidget;
@@ -118,6 +246,10 @@ public:
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 	virtual void TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+	/* Routed to UAGR_AnimMasterSubsystem while the subsystem ticks the component, Activate / Deactivate go through here too */
+	virtual void SetComponentTickEnabled(bool bEnabled) override;
+	virtual void SetComponentTickEnabledAsync(bool bEnabled) override;
+
 	UFUNCTION(BlueprintCallable, Category = "AGR|Poses")
 	void SetupBasePose(FGameplayTag InBasePose);
 
@@ -155,8 +287,17 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "AGR|Tick")
 	void TurnInPlaceTick();
 
+	/* Called by UAGR_AnimMasterSubsystem when the character changes significance bucket. Null = beyond all buckets. */
+	void ApplySignificanceBucket(const FAGRSignificanceBucket* Bucket);
+
+	/* Full aim update if the significance bucket allows one this tick, otherwise only the aim turn in place needs */
+	void SignificantAimTick();
+
 protected:
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
 	//Function that recasts the result of GetOwner to character and sets a few references for the movement component and the owner itself.
@@ -170,39 +311,65 @@ private:
 
 	void LookAtWithoutCamera();
 
+	/* Aims at the focal point of the AI controller without any trace. False if not controlled by an AI controller. */
+	bool LookAtAIFocus();
+
+	/* Traces the aim ray, synchronously or async depending on AimTraceMode. bUpdateAimOffset also aims the socket at the result. */
+	void TraceAim(const FVector& Start, const FVector& End, const bool bUpdateAimOffset);
+
+	/* Called by the world once the async trace finished, whenever the component ticks next */
+	void OnAsyncAimTraceDone(const FTraceHandle& TraceHandle, FTraceDatum& TraceDatum);
+
+	/* Result of a trace queued in UAGR_AnimMasterSubsystem */
+	void ApplyBatchedAimTrace(const FAGRAimTraceRequest& Request);
+
+	bool CanReuseAimTrace(const FVector& Start, const FVector& Direction, const bool bUpdateAimOffset);
+	void StoreAimTrace(const FVector& Start, const FVector& End, const FHitResult& HitResult, const bool bHit, const bool bUpdateAimOffset);
+
+	/* Sets LookAtLocation (and AimOffset) to the impact point, or the trace end if nothing was hit */
+	void ApplyAimTraceResult(const FHitResult& HitResult, const bool bHit, const bool bUpdateAimOffset);
+	void ApplyAimTarget(const FVector& Target, const bool bUpdateAimOffset);
+
+	/* Sends AimOffset and LookAtLocation to the server if they changed enough and the update rate allows it */
+	void UpdateNetAimState();
+
 	UFUNCTION()
-	void OnRep_RotationMethod();
+	void OnRep_NetAimState();
+
+	void PushAimSample(const FRotator& InAimOffset, const FVector& InLookAtLocation);
+
+	/* Sets AimOffset and LookAtLocation of a simulated proxy from the sample buffer */
+	void SampleRemoteAim();
+
+	const FAimSample& GetAimSample(const int32 Age) const
+	{
+		return AimSamples[(AimSampleHead - 1 - Age + AimSampleCapacity) % AimSampleCapacity];
+	}
 
+	/* A setup property came from the server, SentSetupState may no longer match it so the next sync always sends */
 	UFUNCTION()
-	void OnRep_RotationSpeed();
+	void OnRep_SetupState();
 
-	UFUNCTION(Server, Reliable)
-	void ServerSetBasePose(const FGameplayTag InBasePose);
+	UFUNCTION()
+	void OnRep_RotationMethod();
 
-	UFUNCTION(Server, Reliable)
-    void ServerSetOverlayPose(const FGameplayTag InOverlayPose);
+	UFUNCTION()
+	void OnRep_RotationSpeed();
 
-	UFUNCTION(Server, Reliable)
-	void ServerSetRotation(
-		const ERotationMethod InRotationMethod,
-		const float InRotationSpeed,
-		const float InTurnStartAngle,
-		const float InTurnStopTolerance);
+	/* Sends the setup to the server on the next tick, so several Setup* calls in one frame share one RPC */
+	void RequestSetupSync();
 
-	UFUNCTION(Server, Unreliable)
-	void ServerSetupAimOffset(const EAimOffsets InAimOffsetType, const EAimOffsetClamp InAimBehavior);
+	void FlushSetupSync();
 
-	UFUNCTION(Server, Unreliable)
-	void ServerSetAimOffset(const FRotator InAimOffset);
+	FAGRAnimSetupState GetSetupState() const;
 
-	UFUNCTION(NetMulticast, Unreliable)
-	void NetMutiSetAimOffset(const FRotator InAimOffset);
+	UFUNCTION(Server, Reliable)
+	void ServerSetSetupState(const FAGRAnimSetupState& InSetupState);
 
 	UFUNCTION(Server, Unreliable)
-	void ServerSetLookAt(const FVector LookAt);
+	void ServerSetAimState(const FAGRNetAimState& InAimState);
 
-	UFUNCTION(NetMulticast, Unreliable)
-	void NetMutiSetLookAt(const FVector LookAt);
+	friend class UAGR_AnimMasterSubsystem;
 
 	#if WITH_EDITOR
 	/** Setup and register Gameplay Debug Widget. Handles input binding for activation of the widget */
@@ -3,29 +3,156 @@
 #pragma once
 #include "CoreMinimal.h"
 #include "Data/AGRTypes.h"
+#include "Data/DA_AGR_EquipmentSchema.h"
 #include "Components/ActorComponent.h"
 
 #include "AGR_EquipmentManager.generated.h"
 
 struct FGameplayTag;
 
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE(FOnEquipmentChanged, UAGR_EquipmentManager, OnEquipmentChanged);
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_TwoParams(FOnEquipmentSlotChanged, UAGR_EquipmentManager, OnEquipmentSlotChanged, FName, Slot, AActor*, ItemActor);
+
 UCLASS(BlueprintType, Blueprintable,ClassGroup=("AGR"), meta=(BlueprintSpawnableComponent))
 class AGRPRO_API UAGR_EquipmentManager : public UActorComponent
 {
 	GENERATED_BODY()
 
 public:
-	UPROPERTY(BlueprintReadWrite, EditAnywhere, Replicated, SaveGame, Category="AGR|Game Play")
+	/* Shared slot layout. Takes precedence over InlineSlots. */
+	UPROPERTY(BlueprintReadOnly, EditAnywhere, ReplicatedUsing = OnRep_SlotLayout, SaveGame, Category="AGR|Game Play")
+	UDA_AGR_EquipmentSchema* SlotSchema = nullptr;
+
+	/* Per character slot layout, used when no SlotSchema is set (see SetupDefineSlots) */
+	UPROPERTY(BlueprintReadOnly, EditAnywhere, ReplicatedUsing = OnRep_SlotLayout, SaveGame, Category="AGR|Game Play")
+	TArray<FAGREquipmentSlotDefinition> InlineSlots;
+
+	/* Item per slot. Edit through the functions below. */
+	UPROPERTY(BlueprintReadOnly, Replicated, SaveGame, Category="AGR|Game Play")
+	FAGREquipmentList SlotEntries;
+
+	/* Slots and items of older versions. Converted to InlineSlots and SlotEntries on load and BeginPlay, then emptied. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR|Game Play", meta=(DeprecatedProperty, DeprecationMessage="Use InlineSlots or SlotSchema to define slots and SetupDefineSlots at runtime"))
 	TArray<FEquipment> EquipmentList;
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR|Game Play")
 	TMap<FName, AActor*> References;
 
+	/* Number of entries in Shortcuts */
+	UPROPERTY(BlueprintReadOnly, EditAnywhere, Category="AGR|Shortcuts", meta=(ClampMin="0", ClampMax="255", UIMin="0", UIMax="255"))
+	int32 ShortcutCapacity = 10;
+
+	/* Hotbar: ItemId per shortcut index, an invalid id is an empty shortcut. Only replicated to the owner. */
+	UPROPERTY(BlueprintReadOnly, Replicated, SaveGame, Category="AGR|Shortcuts")
+	TArray<FGuid> Shortcuts;
+
+	/* Fires once per changed slot, on the server and on clients as the slot replicates. ItemActor is null when emptied. */
+	UPROPERTY(BlueprintAssignable, Category="AGR|Events")
+	FOnEquipmentSlotChanged OnEquipmentSlotChanged;
+
+	/* Fires once after a batch of slot changes (a single equip, a whole loadout, a received update on clients) */
+	UPROPERTY(BlueprintAssignable, Category="AGR|Events")
+	FOnEquipmentChanged OnEquipmentChanged;
+
+	/**
+	 * How skeletal meshes of items in cosmetic slots follow the owner mesh. Rebuilt the frame after a cosmetic slot changes.
+	 * Leader Pose: item meshes copy the owner pose instead of evaluating their own.
+	 * Merged Mesh: item meshes are merged into a single mesh driven by the owner mesh, the item meshes are hidden and
+	 * stop ticking. Source meshes need CPU access in cooked builds. Falls back to Leader Pose if the merge fails.
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR|Cosmetics")
+	EAGRMeshMergeMode MeshMergeMode = EAGRMeshMergeMode::None;
+
+	/* Stats of all equipped items. Updated per slot change, read it instead of walking the items. */
+	UPROPERTY(BlueprintReadOnly, Transient, Category="AGR|Stats")
+	FAGREquipmentStats EquipmentStats;
+
+private:
+	/* What each slot added to EquipmentStats, so it can be taken out again even if the item is gone */
+	struct FAppliedSlotStats
+	{
+		/* Keyed rather than weak so a destroyed item still differs from an empty slot */
+		TObjectKey<AActor> ItemKey;
+		TArray<FAGRItemAttributeModifier> Modifiers;
+		float Weight = 0.0f;
+		bool bHasContribution = false;
+	};
+	TArray<FAppliedSlotStats> AppliedSlotStats;
+
+	/* Item components Shortcuts resolved to, same index. Checked against the id on read. */
+	TArray<TWeakObjectPtr<UAGR_ItemComponent>> ShortcutCache;
+
+	struct FCosmeticMesh
+	{
+		TWeakObjectPtr<USkeletalMeshComponent> MeshComponent;
+		bool bMerged = false;
+		bool bWasTickEnabled = false;
+	};
+
+	/* Item meshes currently following, or merged into, the owner mesh */
+	TArray<FCosmeticMesh> CosmeticMeshes;
+
+	UPROPERTY(Transient)
+	USkeletalMeshComponent* MergedMeshComponent = nullptr;
+
+	bool bCosmeticRebuildPending = false;
+
+	struct FPredictedSlotChange
+	{
+		int32 SlotIndex = INDEX_NONE;
+		TWeakObjectPtr<AActor> PreviousItemActor;
+
+		/* An authoritative update for the slot arrived after the prediction, nothing to roll back */
+		bool bServerUpdated = false;
+	};
+
+	struct FPredictedItemVisual
+	{
+		TWeakObjectPtr<AActor> ItemActor;
+		bool bWasHidden = false;
+		bool bPredictedEquip = false;
+	};
+
+	struct FEquipmentPrediction
+	{
+		uint16 PredictionKey = 0;
+		TArray<FPredictedSlotChange, TInlineAllocator<2>> SlotChanges;
+		TArray<FPredictedItemVisual, TInlineAllocator<2>> ItemVisuals;
+	};
+
+	/* Owning client: predictions waiting for the server to acknowledge them */
+	TArray<FEquipmentPrediction> PendingPredictions;
+	uint16 LastPredictionKey = 0;
+
+	/* Slot id -> slot index, only used for InlineSlots. Schemas keep their own lookup. */
+	TMap<FName, int32> InlineSlotIndexMap;
+
+	/* Acceptance masks of InlineSlots, built on first use */
+	FAGREquipmentAcceptance InlineAcceptance;
+
+	/* Slot index -> index in SlotEntries.Items. Differs from the slot index on clients. */
+	TArray<int32> SlotEntryMap;
+
+	/* Equipped item -> slot index */
+	TMap<TObjectKey<AActor>, int32> ItemSlotMap;
+
+	/* Size of SlotEntries.Items when the maps were built, catches entries added or removed behind our back */
+	int32 SlotMapsListNum = INDEX_NONE;
+
 public:
 	UAGR_EquipmentManager();
 
 	virtual void TickComponent(const float DeltaTime, const ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual void PostInitProperties() override;
+	virtual void PostLoad() override;
+
+	/* Slots with their items. Builds a new array on every call. */
+	UFUNCTION(BlueprintCallable, BlueprintPure,Category="AGR")
+	TArray<FEquipment> GetEquipmentSlots() const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure,Category="AGR")
+	const TArray<FAGREquipmentSlotDefinition>& GetSlotDefinitions() const;
 
 	UFUNCTION(BlueprintCallable, BlueprintPure,Category="AGR")
 	UPARAM(DisplayName = "Has Items") bool GetAllItems(UPARAM(DisplayName = "Items") TArray<AActor*>& OutItems);
@@ -45,10 +172,43 @@ public:
 		UPARAM(DisplayName = "PreviousItem") AActor*& OutPreviousItem,
 		UPARAM(DisplayName = "NewItem") AActor*& OutNewItem);
 
-	/* Names need to be unique */
+	/**
+	 * Defines the slots of this character only. Names need to be unique.
+	 * Prefer SetSlotSchema, which shares the layout between characters. Clears SlotSchema.
+	 */
 	UFUNCTION(BlueprintCallable,BlueprintAuthorityOnly,Category="AGR")
 	void SetupDefineSlots(UPARAM(DisplayName = "Equipment") const TArray<FEquipment> InEquipmentList);
 
+	/* Switches to a shared slot layout. Items stay in slots with the same id, items in other slots are dropped from the equipment without being unequipped. */
+	UFUNCTION(BlueprintCallable,BlueprintAuthorityOnly,Category="AGR")
+	void SetSlotSchema(UDA_AGR_EquipmentSchema* InSlotSchema);
+
+	/**
+	 * Predicted EquipItemInSlot for the owning client.
+	 *
+	 * The slot change and the item visuals are applied locally right away, then the server runs EquipItemInSlot and
+	 * acknowledges the prediction. A rejected prediction is rolled back to the replicated state. On the server this
+	 * simply calls EquipItemInSlot.
+	 */
+	UFUNCTION(BlueprintCallable,Category="AGR")
+	UPARAM(DisplayName = "Success") bool PredictEquipItemInSlot(const FName Slot, AActor* ItemActor);
+
+	/* Predicted UnequipItemFromSlot for the owning client, see PredictEquipItemInSlot */
+	UFUNCTION(BlueprintCallable,Category="AGR")
+	UPARAM(DisplayName = "Success") bool PredictUnequipItemFromSlot(const FName Slot);
+
+	/**
+	 * Equips several slots at once. Slots not listed keep their item.
+	 *
+	 * All entries are validated first, nothing changes if one of them fails. Items leaving the equipment are unequipped,
+	 * then all slots are written in one pass and new items are equipped. Items only moving between slots are not
+	 * unequipped and equipped again. The slot changes replicate as a single update.
+	 */
+	UFUNCTION(BlueprintCallable,BlueprintAuthorityOnly,Category="AGR")
+	UPARAM(DisplayName = "Success") bool ApplyLoadout(
+		const TArray<FAGREquipmentLoadoutEntry>& Loadout,
+		UPARAM(DisplayName = "Note") FText& OutNote);
+
 	UFUNCTION(BlueprintCallable,BlueprintAuthorityOnly,Category="AGR")
 	UPARAM(DisplayName = "Success") bool UnequipItemFromSlot(const FName Slot, UPARAM(DisplayName = "ItemUnequipped") AActor*& OutItemUnequipped);
 
@@ -59,6 +219,43 @@ public:
 	UFUNCTION(BlueprintCallable,Category="AGR")
 	UPARAM(DisplayName = "Success") bool GetItemInSlot(const FName Slot, UPARAM(DisplayName = "Item") AActor*& OutItem);
 
+	/**
+	 * Finds the slots accepting the item. Empty slots come first, then occupied ones, both in layout order.
+	 * The slot the item is equipped in is skipped.
+	 */
+	UFUNCTION(BlueprintCallable, BlueprintPure,Category="AGR")
+	UPARAM(DisplayName = "Found") bool FindBestSlotsForItem(AActor* ItemActor, UPARAM(DisplayName = "Slots") TArray<FName>& OutSlots);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure,Category="AGR")
+	UPARAM(DisplayName = "Equipped") bool GetSlotOfItem(AActor* ItemActor, UPARAM(DisplayName = "Slot") FName& OutSlot);
+
+	/* Rebuilds the slot lookup tables. Only needed after editing the slot layout or SlotEntries directly. */
+	UFUNCTION(BlueprintCallable,Category="AGR")
+	void RebuildSlotMaps();
+
+	/* Attribute of all equipped items applied to BaseValue: (BaseValue + Sum) * Product */
+	UFUNCTION(BlueprintCallable, BlueprintPure,Category="AGR")
+	float GetEquipmentAttribute(const FGameplayTag Attribute, const float BaseValue = 0.0f) const;
+
+	/* Call after changing AttributeModifiers or Weight of an equipped item */
+	UFUNCTION(BlueprintCallable,Category="AGR")
+	void RefreshItemStats(AActor* ItemActor);
+
+	/* Rebuilds the cosmetic meshes right away. Happens on its own the frame after a cosmetic slot changed. */
+	UFUNCTION(BlueprintCallable,Category="AGR|Cosmetics")
+	void RebuildCosmeticMeshes();
+
+	/* Points the shortcut at the item's ItemId. Null clears it. Owning clients send the change to the server. */
+	UFUNCTION(BlueprintCallable,Category="AGR|Shortcuts")
+	UPARAM(DisplayName = "Success") bool SetShortcut(const int32 Index, AActor* Item);
+
+	/**
+	 * Item the shortcut points at.
+	 * Fails for empty shortcuts, destroyed items, pooled items with a new id and items no longer owned by our owner.
+	 */
+	UFUNCTION(BlueprintCallable, BlueprintPure,Category="AGR|Shortcuts")
+	UPARAM(DisplayName = "Found") bool GetShortcut(const int32 Index, UPARAM(DisplayName = "Item") AActor*& OutItem);
+
 	UFUNCTION(BlueprintCallable,Category="AGR")
 	void SaveShortcutReference(const FName Key, AActor* Item);
 
@@ -66,5 +263,70 @@ public:
 	UPARAM(DisplayName = "Found") bool GetShortcutReference(const FName Key, UPARAM(DisplayName = "Actor") AActor*& OutActor);
 
 protected:
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
 	virtual void BeginPlay() override;
+
+	/* Moves the deprecated EquipmentList into InlineSlots and SlotEntries */
+	void ConvertLegacyEquipmentList();
+
+private:
+	int32 FindSlotIndex(const FName Slot);
+	int32 FindItemSlotIndex(const AActor* ItemActor);
+
+	int32 FindEntryIndex(const int32 SlotIndex);
+	const FAGREquipmentAcceptance& GetAcceptance();
+	AActor* GetSlotItem(const int32 SlotIndex);
+
+	/* Puts the item in the slot and keeps the lookup tables in sync. Does not call equip / unequip on the items. */
+	void SetSlotItem(const int32 SlotIndex, AActor* ItemActor, const bool bBroadcast = true);
+
+	/* Takes the previous item of the slot out of EquipmentStats and adds ItemActor */
+	void UpdateSlotStats(const int32 SlotIndex, AActor* ItemActor, const bool bForce = false);
+	void RemoveSlotContribution(FAppliedSlotStats& Applied);
+	void RebuildStats();
+
+	/* Server side: creates one entry per slot of the current layout. ItemsBySlot is indexed like the layout. */
+	void ResetSlotEntries(const TArray<AActor*>& ItemsBySlot);
+
+	UFUNCTION()
+	void OnRep_SlotLayout();
+
+	/* Client side: a single slot was added, changed or is about to be removed */
+	void OnSlotReplicated(const FAGREquipmentSlotEntry& Entry, const bool bRemoved);
+
+	/* Schedules RebuildCosmeticMeshes for the next tick if the slot is cosmetic. INDEX_NONE = any slot. */
+	void RequestCosmeticRebuild(const int32 SlotIndex);
+	void ReleaseCosmeticMeshes();
+	USkeletalMeshComponent* GetOwnerMesh() const;
+
+	/* Shared checks of EquipItemInSlot and its predicted version */
+	bool CanEquipInSlot(const int32 SlotIndex, AActor* ItemActor, UAGR_ItemComponent*& OutItemComponent);
+
+	/* Server side check of items sent by the client: owned by our owner and in its inventory or equipped here */
+	bool IsItemOfOwner(AActor* ItemActor);
+
+	uint16 GetNextPredictionKey();
+
+	/* Remembers the current item of the slot in the prediction, then writes the new one locally */
+	void PredictSlotItem(FEquipmentPrediction& Prediction, const int32 SlotIndex, AActor* ItemActor);
+	void RollbackPrediction(const FEquipmentPrediction& Prediction);
+
+	UFUNCTION(Server, Reliable)
+	void ServerSetShortcut(const uint8 Index, const FGuid ItemId);
+
+	UFUNCTION(Server, Reliable)
+	void ServerPredictEquip(const FName Slot, AActor* ItemActor, const uint16 PredictionKey);
+
+	UFUNCTION(Server, Reliable)
+	void ServerPredictUnequip(const FName Slot, const uint16 PredictionKey);
+
+	UFUNCTION(Client, Reliable)
+	void ClientAckPrediction(const uint16 PredictionKey, const bool bAccepted);
+
+	/* Client side: all slots of an update were received */
+	void OnEquipmentReplicated();
+
+	friend struct FAGREquipmentSlotEntry;
+	friend struct FAGREquipmentList;
 };
@@ -4,10 +4,30 @@
 #include "CoreMinimal.h"
 #include "GameplayTagContainer.h"
 #include "Components/ActorComponent.h"
+#include "Engine/StreamableManager.h"
 
 #include "AGR_InventoryManager.generated.h"
 
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnItemUpdated, AActor*, Item);
+class UAGR_InventoryManager;
+
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_OneParam(FOnItemUpdated, UAGR_InventoryManager, OnItemUpdated, AActor*, Item);
+
+/* Stackable add waiting for its item class to finish streaming in */
+USTRUCT()
+struct FAGRPendingItemAdd
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TSoftClassPtr<AActor> Class;
+
+	UPROPERTY()
+	int32 Quantity = 0;
+
+	int32 RequestId = INDEX_NONE;
+
+	TSharedPtr<FStreamableHandle> Handle;
+};
 
 UCLASS(BlueprintType, Blueprintable,ClassGroup=("AGR"), meta=(BlueprintSpawnableComponent))
 class AGRPRO_API UAGR_InventoryManager : public UActorComponent
@@ -30,6 +50,13 @@ public:
 	UPROPERTY(BlueprintAssignable, EditAnywhere, Category = "AGR|Events")
 	FOnItemUpdated OnItemUpdated;
 
+private:
+	/* Adds queued by AddItemsOfSoftClass whose class is still loading */
+	UPROPERTY(Transient)
+	TArray<FAGRPendingItemAdd> PendingItemAdds;
+
+	int32 LastPendingRequestId = 0;
+
 public:
 	UAGR_InventoryManager();
 
@@ -45,6 +72,19 @@ public:
 	UFUNCTION(BlueprintCallable,BlueprintAuthorityOnly,Category="AGR")
 	UPARAM(DisplayName = "Success") bool AddItemsOfClass(const TSubclassOf<AActor> Class, const int32 Quantity, FText& OutNote);
 
+	//~ TODO "FText& OutNote" should be an enum to signal the actual outcome
+	/**
+	 * Same as AddItemsOfClass but the item class does not need to be loaded. If it isn't, the add is queued, the class
+	 * is streamed in asynchronously and the items are added once loading finishes (OnItemUpdated fires as usual).
+	 * HasEnoughItems counts queued quantities when asked to include pending items. Only works for stackable items.
+	 */
+	UFUNCTION(BlueprintCallable,BlueprintAuthorityOnly,Category="AGR")
+	UPARAM(DisplayName = "Success") bool AddItemsOfSoftClass(const TSoftClassPtr<AActor> Class, const int32 Quantity, FText& OutNote);
+
+	/* Quantity of the class still waiting for its class to be loaded */
+	UFUNCTION(BlueprintCallable, BlueprintPure,Category="AGR")
+	int32 GetPendingQuantityOfClass(const TSoftClassPtr<AActor> Class) const;
+
 	//~ TODO "FText& OutNote" should be an enum to signal the actual outcome
 	UFUNCTION(BlueprintCallable,BlueprintAuthorityOnly,Category="AGR")
 	UPARAM(DisplayName = "Success") bool RemoveItemsOfClass(const TSubclassOf<AActor> Class, const int32 Quantity, FText& OutNote);
@@ -59,7 +99,15 @@ public:
 
 	//~ TODO "FText& OutNote" should be an enum to signal the actual outcome
 	UFUNCTION(BlueprintCallable,Category="AGR")
-	UPARAM(DisplayName = "Success") bool HasEnoughItems(const TSubclassOf<AActor> Item, const int32 Quantity, FText& OutNote);
+	UPARAM(DisplayName = "Success") bool HasEnoughItems(const TSubclassOf<AActor> Item, const int32 Quantity, FText& OutNote, const bool bIncludePending = false);
+
+	/**
+	 * Same as HasEnoughItems for a class that may not be loaded yet, e.g. one passed to AddItemsOfSoftClass.
+	 * An unloaded class can't have any items in the inventory, so only queued quantities count for it.
+	 */
+	//~ TODO "FText& OutNote" should be an enum to signal the actual outcome
+	UFUNCTION(BlueprintCallable,Category="AGR")
+	UPARAM(DisplayName = "Success") bool HasEnoughItemsOfSoftClass(const TSoftClassPtr<AActor> Class, const int32 Quantity, FText& OutNote, const bool bIncludePending = true);
 
 	UFUNCTION(BlueprintCallable,Category="AGR")
 	UPARAM(DisplayName = "Success") bool GetAllItemsOfTagSlotType(const FGameplayTag SlotTypeFilter, TArray<AActor*>& OutItemsWithTag);
@@ -71,7 +119,12 @@ public:
 	UPARAM(DisplayName = "Success") bool HasExactItem(AActor* Item);
 
 protected:
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	void OnPendingItemClassLoaded(const int32 RequestId);
 
 	/**
 	 * Basically, for pawns we store items on player state that replcaites with the player itself.
@@ -9,13 +9,15 @@
 #include "AGR_ItemComponent.generated.h"
 
 class UAGR_InventoryManager;
+class UAGR_ItemComponent;
 
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnPickup, UAGR_InventoryManager*, Inventory);
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnHiddenShown, bool, bHidden);
-DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnItemDropped);
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnItemUsed, AActor*, User);
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnEquip, AActor*, User);
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnUnequip, AActor*, User);
+/* Sparse: most items never get a listener bound, so an unbound event costs a single byte per item */
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_OneParam(FOnPickup, UAGR_ItemComponent, OnPickup, UAGR_InventoryManager*, Inventory);
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_OneParam(FOnHiddenShown, UAGR_ItemComponent, OnHiddenShown, bool, bHidden);
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE(FOnItemDropped, UAGR_ItemComponent, OnItemDropped);
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_OneParam(FOnItemUsed, UAGR_ItemComponent, OnItemUsed, AActor*, User);
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_OneParam(FOnEquip, UAGR_ItemComponent, OnEquip, AActor*, User);
+DECLARE_DYNAMIC_MULTICAST_SPARSE_DELEGATE_OneParam(FOnUnequip, UAGR_ItemComponent, OnUnequip, AActor*, User);
 
 UCLASS(BlueprintType, Blueprintable,ClassGroup=("AGR"), meta=(BlueprintSpawnableComponent))
 class AGRPRO_API UAGR_ItemComponent : public UActorComponent
@@ -24,11 +26,13 @@ class AGRPRO_API UAGR_ItemComponent : public UActorComponent
 
 	friend UAGR_EquipmentManager;
 	friend UAGR_InventoryManager;
+	friend class UAGR_ItemSubsystem;
 
 public:
 	static const FName TAG_ITEM;
 
-	UPROPERTY(BlueprintReadWrite, EditAnywhere, Replicated, SaveGame, Category="AGR|Identification")
+	/* Handle of the item, e.g. for shortcuts. Change it at runtime through SetItemId so lookups by id stay in sync. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, ReplicatedUsing = OnRep_ItemId, SaveGame, Category="AGR|Identification")
 	FGuid ItemId;
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Replicated, SaveGame, Category="AGR|Identification")
@@ -64,6 +68,21 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Replicated, Category="AGR|Base Info")
 	FGameplayTag ItemTagSlotType;
 
+	/* Added to the stats of the equipment manager while the item is equipped. Call RefreshItemStats there after changing them. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Replicated, Category="AGR|Stats")
+	TArray<FAGRItemAttributeModifier> AttributeModifiers;
+
+	/* Dropped items with lower priority are despawned first. See AGR Items project settings for the protected priority. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR|Base Info")
+	int32 DespawnPriority = 0;
+
+	/* When hidden in an inventory, unregister the item's primitive components so they drop their render and physics state */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR|Base Info")
+	bool bStashWhenHidden = false;
+
+	UPROPERTY(BlueprintReadOnly, ReplicatedUsing = OnRep_Stashed, Category="AGR|Base Info")
+	bool bStashed = false;
+
 	UPROPERTY(BlueprintAssignable, EditAnywhere, Category = "AGR|Events")
 	FOnPickup OnPickup;
 
@@ -82,6 +101,17 @@ public:
 	UPROPERTY(BlueprintAssignable, EditAnywhere, Category = "AGR|Events")
 	FOnUnequip OnUnequip;
 
+private:
+	/* Index in the world's dropped item grid (UAGR_ItemSubsystem). INDEX_NONE while not lying in the world. */
+	int32 DroppedItemIndex = INDEX_NONE;
+
+	/* Id the item is registered with in UAGR_ItemSubsystem */
+	FGuid RegisteredItemId;
+
+	/* Components unregistered by the stash, registered again when the item is shown */
+	UPROPERTY(Transient)
+	TArray<UPrimitiveComponent*> StashedComponents;
+
 public:
 	UAGR_ItemComponent();
 
@@ -97,12 +127,45 @@ public:
 	UFUNCTION(BlueprintCallable,BlueprintAuthorityOnly,Category="AGR")
 	void UseItem(AActor* User) const;
 
+	/* Gives the item a new id (e.g. when it is reused from a pool). Shortcuts to the old id stop resolving to it. */
+	UFUNCTION(BlueprintCallable,BlueprintAuthorityOnly,Category="AGR")
+	void SetItemId(const FGuid NewItemId);
+
 protected:
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
-	void HideShowItem(const bool bHide) const;
-	void EquipInternal() const;
+	void HideShowItem(const bool bHide);
+	void EquipInternal();
 	void UnequipInternal() const;
 
+	/* Owning client: shows the item as equipped / unequipped before the server confirms it */
+	void EquipPredicted() const;
+	void UnequipPredicted() const;
+
+	/* Owning client: drops a rejected prediction and goes back to the replicated state */
+	void RevertPredicted(const bool bWasHidden, const bool bPredictedEquip) const;
+
+	/* Unregisters (stash) or registers again (unstash) the primitive components of the item */
+	void ApplyStash(const bool bStash);
+
+	UFUNCTION()
+	void OnRep_Stashed();
+
+	/* Moves the item id registration to the current ItemId */
+	void RefreshItemIdRegistration();
+
+	UFUNCTION()
+	void OnRep_ItemId();
+
+	void RegisterInWorld(const bool bDropped = false);
+	void UnregisterFromWorld();
+	void RefreshWorldLocation();
+
+	UFUNCTION()
+	void OnDroppedItemSleep(UPrimitiveComponent* SleepingComponent, FName BoneName);
+
 };
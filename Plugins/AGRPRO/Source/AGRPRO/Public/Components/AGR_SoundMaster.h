@@ -3,6 +3,7 @@
 #pragma once
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "Data/AGRTraceContext.h"
 #include "NiagaraComponent.h"
 
 #include "AGR_SoundMaster.generated.h"
@@ -10,6 +11,7 @@
 class ACharacter;
 class UDA_AGR_FootstepConfig;
 class USoundCue;
+struct FAGRSignificanceBucket;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_FiveParams(FCharacterMadeFootstepSound, FHitResult, HitEvent,float, VolumeMulti,UAudioComponent*, Sound, UNiagaraSystem* , Particle,FName, Key);
 
@@ -64,9 +66,14 @@ public:
 	TEnumAsByte<ECollisionChannel> TraceChannel = ECollisionChannel::ECC_Visibility;
 
 private:
+	FAGRTraceContext TraceContext;
+
 	FTimerHandle AutofootstepGateTimerHandle;
 	bool bAutofootstepGateopen = true;
 
+	/* Cleared by the significance bucket of the character */
+	bool bFootstepsSignificant = true;
+
 public:	
 	// Sets default values for this component's properties
 	UAGR_SoundMaster();
@@ -84,9 +91,15 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "AGR|Footstep")
 	void TestAllFeetForCollision();
 
+	/* Called by UAGR_AnimMasterSubsystem when the character changes significance bucket. Null = beyond all buckets. */
+	void ApplySignificanceBucket(const FAGRSignificanceBucket* Bucket);
+
 protected:
 	// Called when the game starts
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = "AGR|Footstep")
 	float OverwriteCalcVolume() const;
@@ -0,0 +1,70 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "AGRAnimSettings.generated.h"
+
+/* What AGR components of a character do at a given distance from the closest viewer */
+USTRUCT(BlueprintType)
+struct FAGRSignificanceBucket
+{
+	GENERATED_BODY();
+
+	/** Characters closer than this (cm) to the closest viewer use this bucket */
+	UPROPERTY(config, EditAnywhere, Category="AGR", meta=(ClampMin="0.0", UIMin="0.0"))
+	float MaxDistance = 0.0f;
+
+	/** Seconds between aim updates (traces, look-at) of the AnimMaster component. 0 = every tick. */
+	UPROPERTY(config, EditAnywhere, Category="AGR", meta=(ClampMin="0.0", UIMin="0.0"))
+	float AimTickInterval = 0.0f;
+
+	/** Let the AnimMaster component trace and update aim. Turn in place always runs, it drives the character rotation. */
+	UPROPERTY(config, EditAnywhere, Category="AGR")
+	bool bAim = true;
+
+	/** Let the SoundMaster component trace and play footsteps */
+	UPROPERTY(config, EditAnywhere, Category="AGR")
+	bool bFootsteps = true;
+};
+
+/**
+ * Settings for AGR animation and sound components
+ */
+UCLASS(Config="Game", defaultconfig, meta=(DisplayName="AGR Animation"))
+class AGRPRO_API UAGRAnimSettings : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Scale AnimMaster aim and SoundMaster footstep work by the significance of their character (distance, visibility) */
+	UPROPERTY(config, EditAnywhere, Category="Significance")
+	bool bUseSignificance;
+
+	/** Buckets by ascending MaxDistance. Characters beyond the last bucket neither trace aim nor play footsteps. */
+	UPROPERTY(config, EditAnywhere, Category="Significance", meta=(EditCondition="bUseSignificance"))
+	TArray<FAGRSignificanceBucket> SignificanceBuckets;
+
+	/** Characters not rendered recently count as this many times farther away. Not used on dedicated servers. */
+	UPROPERTY(config, EditAnywhere, Category="Significance", meta=(ClampMin="1.0", UIMin="1.0", EditCondition="bUseSignificance"))
+	float NotRenderedDistanceScale;
+
+	/** Feed the viewpoints of all player controllers to the significance manager. Disable if the game updates it itself. */
+	UPROPERTY(config, EditAnywhere, Category="Significance", meta=(EditCondition="bUseSignificance"))
+	bool bUpdateSignificanceManager;
+
+	/**
+	 * Tick all AnimMaster components from one loop in the AnimMaster subsystem instead of their own tick functions.
+	 * Saves the per component tick dispatch with many characters. Components then update at the end of the frame.
+	 * Blueprint subclasses implementing Event Tick are left on their own tick function.
+	 */
+	UPROPERTY(config, EditAnywhere, Category="Tick")
+	bool bManageAnimMasterTicks;
+
+public:
+	UAGRAnimSettings();
+
+	/* Bucket index for a distance, INDEX_NONE beyond the last bucket */
+	int32 GetSignificanceBucket(const float Distance) const;
+};
@@ -0,0 +1,83 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+
+#include "AGRComponentTableProvider.generated.h"
+
+class UAGR_EquipmentManager;
+class UAGR_InventoryManager;
+class UAGR_ItemComponent;
+class UAGR_SoundMaster;
+class UAGRAnimMasterComponent;
+
+/* AGR components of one actor. Filled by the components themselves on register, read by UAGRLibrary. */
+struct AGRPRO_API FAGRComponentTable
+{
+	UAGR_ItemComponent* ItemComponent = nullptr;
+	UAGR_InventoryManager* Inventory = nullptr;
+	UAGR_EquipmentManager* Equipment = nullptr;
+	UAGRAnimMasterComponent* AnimationMaster = nullptr;
+	UAGR_SoundMaster* Sound = nullptr;
+
+	/**
+	 * Called from OnRegister / OnUnregister of the AGR components. Like GetComponentByClass the first component wins.
+	 * When it unregisters the next registered component of the class takes its place, so the table is always complete.
+	 */
+	template<typename ComponentType>
+	static void Update(ComponentType* Component, ComponentType* FAGRComponentTable::* Entry, const bool bRegistered);
+};
+
+UINTERFACE(MinimalAPI, meta=(CannotImplementInterfaceInBlueprint))
+class UAGRComponentTableProvider : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/**
+ * Actors keeping an FAGRComponentTable. UAGRLibrary accessors then cost one pointer load instead of a component scan.
+ * Implemented by AAGRCharacter and AAGRItemActor, other actors fall back to GetComponentByClass.
+ */
+class AGRPRO_API IAGRComponentTableProvider
+{
+	GENERATED_BODY()
+
+public:
+	virtual FAGRComponentTable& GetAGRComponentTable() = 0;
+};
+
+template<typename ComponentType>
+void FAGRComponentTable::Update(ComponentType* Component, ComponentType* FAGRComponentTable::* Entry, const bool bRegistered)
+{
+	IAGRComponentTableProvider* Provider = Cast<IAGRComponentTableProvider>(Component->GetOwner());
+	if(Provider == nullptr)
+	{
+		return;
+	}
+
+	ComponentType*& TableEntry = Provider->GetAGRComponentTable().*Entry;
+	if(bRegistered)
+	{
+		if(TableEntry == nullptr)
+		{
+			TableEntry = Component;
+		}
+	}
+	else if(TableEntry == Component)
+	{
+		TableEntry = nullptr;
+
+		// UAGRLibrary trusts the table, hand the entry to another component of the same class if there is one
+		TArray<ComponentType*> Components;
+		Component->GetOwner()->GetComponents(Components);
+		for(ComponentType* OtherComponent : Components)
+		{
+			if(OtherComponent != Component && OtherComponent->IsRegistered())
+			{
+				TableEntry = OtherComponent;
+				break;
+			}
+		}
+	}
+}
@@ -0,0 +1,60 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "AGRItemSettings.generated.h"
+
+/**
+ * Settings for AGR items lying in the world
+ */
+UCLASS(Config="Game", defaultconfig, meta=(DisplayName="AGR Items"))
+class AGRPRO_API UAGRItemSettings : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Edge length (in cm) of one cell of the dropped item grid. Should be close to the typical pickup radius. */
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items", meta=(ClampMin="50.0", UIMin="50.0"))
+	float GridCellSize;
+
+	/** Let the item subsystem merge, put to sleep and despawn dropped items. Off by default, items are never touched unasked. */
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items|Lifecycle")
+	bool bManageDroppedItems;
+
+	/** Maximum number of dropped items visited per frame. The subsystem cycles through all items over several frames. */
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items|Lifecycle", meta=(ClampMin="1", UIMin="1", EditCondition="bManageDroppedItems"))
+	int32 MaxItemsProcessedPerFrame;
+
+	/** Merge identical stackable items lying within MergeRadius into as few stacks as possible */
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items|Lifecycle", meta=(EditCondition="bManageDroppedItems"))
+	bool bMergeStackables;
+
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items|Lifecycle", meta=(ClampMin="0.0", UIMin="0.0", EditCondition="bManageDroppedItems && bMergeStackables"))
+	float MergeRadius;
+
+	/** Seconds after the drop before a simulating item may be forced to sleep */
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items|Lifecycle", meta=(ClampMin="0.0", UIMin="0.0", EditCondition="bManageDroppedItems"))
+	float SettleTime;
+
+	/** Simulating items slower than this (cm/s) after SettleTime are put to sleep */
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items|Lifecycle", meta=(ClampMin="0.0", UIMin="0.0", EditCondition="bManageDroppedItems"))
+	float SettleSpeed;
+
+	/** Seconds a dropped item may lie in the world before it is despawned. 0 = never. */
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items|Lifecycle", meta=(ClampMin="0.0", UIMin="0.0", EditCondition="bManageDroppedItems"))
+	float MaxDroppedItemAge;
+
+	/** Maximum number of dropped items in one grid cell. Lowest priority, then oldest items are despawned first. 0 = no cap. */
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items|Lifecycle", meta=(ClampMin="0", UIMin="0", EditCondition="bManageDroppedItems"))
+	int32 MaxItemsPerCell;
+
+	/** Items with a DespawnPriority of at least this value are never despawned by age or count caps */
+	UPROPERTY(config, EditAnywhere, Category="Dropped Items|Lifecycle", meta=(EditCondition="bManageDroppedItems"))
+	int32 ProtectedDespawnPriority;
+
+public:
+	UAGRItemSettings();
+
+};
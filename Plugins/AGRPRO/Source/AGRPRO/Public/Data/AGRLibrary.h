@@ -6,6 +6,7 @@
 #include "Components/AGR_InventoryManager.h"
 #include "Components/AGR_ItemComponent.h"
 #include "Components/AGR_SoundMaster.h"
+#include "Data/AGRComponentTableProvider.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
 
 #include "AGRLibrary.generated.h"
@@ -18,40 +19,47 @@ class AGRPRO_API UAGRLibrary : public UBlueprintFunctionLibrary
 public:
 	FORCEINLINE static UAGR_ItemComponent* GetItemComponent(AActor* Actor)
 	{
-		return IsValid(Actor)
-			? Cast<UAGR_ItemComponent>(Actor->GetComponentByClass(UAGR_ItemComponent::StaticClass()))
-			: nullptr;
+		return FindComponent(Actor, &FAGRComponentTable::ItemComponent);
 	}
 
 	FORCEINLINE static UAGR_InventoryManager* GetInventory(AActor* Actor)
 	{
-		return IsValid(Actor)
-			? Cast<UAGR_InventoryManager>(Actor->GetComponentByClass(UAGR_InventoryManager::StaticClass()))
-			: nullptr;
+		return FindComponent(Actor, &FAGRComponentTable::Inventory);
 	}
 
 	FORCEINLINE static UAGR_EquipmentManager* GetEquipment(AActor* Actor)
 	{
-		return IsValid(Actor)
-			? Cast<UAGR_EquipmentManager>(Actor->GetComponentByClass(UAGR_EquipmentManager::StaticClass()))
-			: nullptr;
+		return FindComponent(Actor, &FAGRComponentTable::Equipment);
 	}
 
 	FORCEINLINE static UAGRAnimMasterComponent* GetAnimationMaster(AActor* Actor)
 	{
-		return IsValid(Actor)
-			? Cast<UAGRAnimMasterComponent>(Actor->GetComponentByClass(UAGRAnimMasterComponent::StaticClass()))
-			: nullptr;
+		return FindComponent(Actor, &FAGRComponentTable::AnimationMaster);
 	}
 
 	FORCEINLINE static UAGR_SoundMaster* GetSound(AActor* Actor)
 	{
-		return IsValid(Actor)
-			? Cast<UAGR_SoundMaster>(Actor->GetComponentByClass(UAGR_SoundMaster::StaticClass()))
-			: nullptr;
+		return FindComponent(Actor, &FAGRComponentTable::Sound);
 	}
 
 private:
+	/* Reads the component table of AGR actors, a miss there is final. Other actors are scanned with GetComponentByClass. */
+	template<typename ComponentType>
+	FORCEINLINE static ComponentType* FindComponent(AActor* Actor, ComponentType* FAGRComponentTable::* Entry)
+	{
+		if(!IsValid(Actor))
+		{
+			return nullptr;
+		}
+
+		if(IAGRComponentTableProvider* Provider = Cast<IAGRComponentTableProvider>(Actor))
+		{
+			return Provider->GetAGRComponentTable().*Entry;
+		}
+
+		return Cast<ComponentType>(Actor->GetComponentByClass(ComponentType::StaticClass()));
+	}
+
 	UFUNCTION(BlueprintCallable, BlueprintPure, DisplayName = "Get Item Component", Category="AGR")
 	static UAGR_ItemComponent* K2_GetItemComponent(AActor* Actor)
 	{
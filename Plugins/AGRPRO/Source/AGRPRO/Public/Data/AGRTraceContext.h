@@ -0,0 +1,49 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "CollisionQueryParams.h"
+
+class AActor;
+class AController;
+class APlayerCameraManager;
+class USceneComponent;
+
+/**
+ * Per character state shared by its traces (aim, footsteps).
+ *
+ * Keeps query params that ignore the character and everything attached to it. The ignore list is only rebuilt when
+ * the attachment tree changes. Also resolves the camera manager of the controller possessing the character, which
+ * is the right camera in splitscreen where player 0 is not.
+ */
+struct AGRPRO_API FAGRTraceContext
+{
+public:
+	void Initialize(AActor* InOwner, const FName TraceTag);
+
+	/* Query params with an up to date ignore list. Flags (bTraceComplex, ...) are left to the caller. */
+	FCollisionQueryParams& GetQueryParams();
+
+	/* Null if the character is not possessed by a player */
+	APlayerCameraManager* GetCameraManager();
+
+	/* Forces a rebuild of the ignore list on the next GetQueryParams */
+	void MarkDirty() { bIgnoreListDirty = true; }
+
+private:
+	TWeakObjectPtr<AActor> Owner;
+
+	FCollisionQueryParams QueryParams;
+
+	/* Hash of the components attached below the owner's root component, see GetAttachmentSignature */
+	uint32 AttachmentSignature = 0;
+	bool bIgnoreListDirty = true;
+
+	/* Reused by the ignore list rebuild */
+	TArray<AActor*> AttachedActors;
+
+	TWeakObjectPtr<AController> CameraController;
+	TWeakObjectPtr<APlayerCameraManager> CameraManager;
+
+	static uint32 GetAttachmentSignature(const USceneComponent* Component);
+};
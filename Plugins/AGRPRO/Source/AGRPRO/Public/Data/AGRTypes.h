@@ -3,9 +3,13 @@
 #pragma once
 #include "CoreMinimal.h"
 #include "GameplayTagContainer.h"
+#include "Engine/NetSerialization.h"
+#include "Net/Serialization/FastArraySerializer.h"
 
 #include "AGRTypes.generated.h"
 
+class UAGR_EquipmentManager;
+
 UENUM(BlueprintType)
 enum class EAimOffsetClamp:uint8
 {
@@ -32,6 +36,200 @@ enum class ERotationMethod:uint8
 	DesiredAtAngle		UMETA(DisplayName = "Desired At Angle")
 };
 
+UENUM(BlueprintType)
+enum class EAGRAimTraceMode:uint8
+{
+	Sync = 0	UMETA(DisplayName = "Sync"),
+	Async		UMETA(DisplayName = "Async"),
+	Batched		UMETA(DisplayName = "Batched")
+};
+
+UENUM(BlueprintType)
+enum class EAGRAILookAtMode:uint8
+{
+	Focus = 0	UMETA(DisplayName = "Controller Focus"),
+	Trace		UMETA(DisplayName = "Trace")
+};
+
+UENUM(BlueprintType)
+enum class EAGRMeshMergeMode:uint8
+{
+	None = 0		UMETA(DisplayName = "None"),
+	LeaderPose		UMETA(DisplayName = "Leader Pose"),
+	MergedMesh		UMETA(DisplayName = "Merged Mesh")
+};
+
+UENUM(BlueprintType)
+enum class EAGRAttributeModifierOp:uint8
+{
+	Additive = 0		UMETA(DisplayName = "Additive"),
+	Multiplicative		UMETA(DisplayName = "Multiplicative")
+};
+
+/* Setup of an AnimMaster component, sent by the owning client in one RPC */
+USTRUCT()
+struct FAGRAnimSetupState
+{
+	GENERATED_BODY();
+
+	UPROPERTY()
+	FGameplayTag BasePose;
+
+	UPROPERTY()
+	FGameplayTag OverlayPose;
+
+	UPROPERTY()
+	ERotationMethod RotationMethod = ERotationMethod::NONE;
+
+	UPROPERTY()
+	float RotationSpeed = 0.0f;
+
+	UPROPERTY()
+	float TurnStartAngle = 0.0f;
+
+	UPROPERTY()
+	float TurnStopTolerance = 0.0f;
+
+	UPROPERTY()
+	EAimOffsets AimOffsetType = EAimOffsets::NONE;
+
+	UPROPERTY()
+	EAimOffsetClamp AimOffsetBehavior = EAimOffsetClamp::Nearest;
+
+	bool operator==(const FAGRAnimSetupState& Other) const
+	{
+		return BasePose == Other.BasePose
+			&& OverlayPose == Other.OverlayPose
+			&& RotationMethod == Other.RotationMethod
+			&& RotationSpeed == Other.RotationSpeed
+			&& TurnStartAngle == Other.TurnStartAngle
+			&& TurnStopTolerance == Other.TurnStopTolerance
+			&& AimOffsetType == Other.AimOffsetType
+			&& AimOffsetBehavior == Other.AimOffsetBehavior;
+	}
+
+	bool operator!=(const FAGRAnimSetupState& Other) const
+	{
+		return !(*this == Other);
+	}
+};
+
+/**
+ * Aim offset and look-at location of a character, quantized for replication.
+ *
+ * Pitch and yaw are packed into 16 bits each, the look-at location is rounded to whole centimeters. Roll is not
+ * sent as aim offsets never use it.
+ */
+USTRUCT()
+struct FAGRNetAimState
+{
+	GENERATED_BODY();
+
+	UPROPERTY()
+	uint16 Pitch = 0;
+
+	UPROPERTY()
+	uint16 Yaw = 0;
+
+	UPROPERTY()
+	FVector_NetQuantize LookAtLocation = FVector_NetQuantize(FVector::ZeroVector);
+
+	void Set(const FRotator& AimOffset, const FVector& InLookAtLocation)
+	{
+		Pitch = FRotator::CompressAxisToShort(AimOffset.Pitch);
+		Yaw = FRotator::CompressAxisToShort(AimOffset.Yaw);
+		LookAtLocation = FVector_NetQuantize(InLookAtLocation.RoundToVector());
+	}
+
+	FRotator GetAimOffset() const
+	{
+		return FRotator(
+			FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(Pitch)),
+			FRotator::NormalizeAxis(FRotator::DecompressAxisFromShort(Yaw)),
+			0.0f);
+	}
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+	{
+		Ar << Pitch;
+		Ar << Yaw;
+		return LookAtLocation.NetSerialize(Ar, Map, bOutSuccess);
+	}
+
+	bool operator==(const FAGRNetAimState& Other) const
+	{
+		return Pitch == Other.Pitch && Yaw == Other.Yaw && LookAtLocation == Other.LookAtLocation;
+	}
+
+	bool operator!=(const FAGRNetAimState& Other) const
+	{
+		return !(*this == Other);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FAGRNetAimState> : public TStructOpsTypeTraitsBase2<FAGRNetAimState>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
+};
+
+/* Numeric attribute an item contributes while equipped (armor, damage bonus, ...) */
+USTRUCT(BlueprintType)
+struct FAGRItemAttributeModifier
+{
+	GENERATED_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR")
+	FGameplayTag Attribute;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR")
+	EAGRAttributeModifierOp Operation = EAGRAttributeModifierOp::Additive;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR")
+	float Value = 0.0f;
+};
+
+/* Running sum and product of all equipped modifiers of one attribute */
+USTRUCT(BlueprintType)
+struct FAGRAttributeAggregate
+{
+	GENERATED_BODY();
+
+	UPROPERTY(BlueprintReadOnly, Category="AGR")
+	float Sum = 0.0f;
+
+	/* Product of the non zero multipliers, see NumZeroMultipliers */
+	UPROPERTY(BlueprintReadOnly, Category="AGR")
+	float Product = 1.0f;
+
+	/* Zero multipliers are counted instead of multiplied so they can be removed again */
+	UPROPERTY(BlueprintReadOnly, Category="AGR")
+	int32 NumZeroMultipliers = 0;
+
+	float Evaluate(const float BaseValue) const
+	{
+		return NumZeroMultipliers > 0 ? 0.0f : (BaseValue + Sum) * Product;
+	}
+};
+
+/* Totals of all equipped items, kept up to date as slots change */
+USTRUCT(BlueprintType)
+struct FAGREquipmentStats
+{
+	GENERATED_BODY();
+
+	UPROPERTY(BlueprintReadOnly, Category="AGR")
+	TMap<FGameplayTag, FAGRAttributeAggregate> Attributes;
+
+	UPROPERTY(BlueprintReadOnly, Category="AGR")
+	float TotalWeight = 0.0f;
+};
+
+/* Slot with its item, as seen from Blueprint. Replication and saving use the split schema / entry layout below. */
 USTRUCT(BlueprintType)
 struct FEquipment
 {
@@ -45,4 +243,97 @@ struct FEquipment
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR")
 	AActor* ItemActor = nullptr;
+
+	/* Skeletal meshes of items in this slot take part in the mesh merge of the equipment manager */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR")
+	bool bCosmetic = false;
+};
+
+/* Static part of an equipment slot, shared by every character using the same layout */
+USTRUCT(BlueprintType)
+struct FAGREquipmentSlotDefinition
+{
+	GENERATED_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, SaveGame, Category="AGR")
+	FName Id;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, SaveGame, Category="AGR")
+	FGameplayTagContainer AcceptableSlots;
+
+	/* Skeletal meshes of items in this slot take part in the mesh merge of the equipment manager */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, SaveGame, Category="AGR")
+	bool bCosmetic = false;
+};
+
+/* Per character part of an equipment slot: the item equipped in the slot at SlotIndex of the slot layout */
+USTRUCT(BlueprintType)
+struct FAGREquipmentSlotEntry : public FFastArraySerializerItem
+{
+	GENERATED_BODY();
+
+	UPROPERTY(BlueprintReadOnly, SaveGame, Category="AGR")
+	uint8 SlotIndex = 0;
+
+	UPROPERTY(BlueprintReadOnly, SaveGame, Category="AGR")
+	AActor* ItemActor = nullptr;
+
+	/* Client side callbacks of FAGREquipmentList */
+	void PreReplicatedRemove(const struct FAGREquipmentList& InArraySerializer);
+	void PostReplicatedAdd(const struct FAGREquipmentList& InArraySerializer);
+	void PostReplicatedChange(const struct FAGREquipmentList& InArraySerializer);
+};
+
+/* One slot of a loadout. A null ItemActor empties the slot. */
+USTRUCT(BlueprintType)
+struct FAGREquipmentLoadoutEntry
+{
+	GENERATED_BODY();
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR")
+	FName Slot;
+
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="AGR")
+	AActor* ItemActor = nullptr;
+};
+
+/**
+ * Equipped items replicated as a fast array, one entry per slot.
+ *
+ * Only slots marked dirty are sent and, with delta serialization enabled, only their changed properties. Equipping
+ * an item therefore sends a single item reference.
+ */
+USTRUCT(BlueprintType)
+struct FAGREquipmentList : public FFastArraySerializer
+{
+	GENERATED_BODY();
+
+	UPROPERTY(BlueprintReadOnly, SaveGame, Category="AGR")
+	TArray<FAGREquipmentSlotEntry> Items;
+
+	/* Receives the per slot callbacks on clients */
+	UPROPERTY(NotReplicated, Transient)
+	UAGR_EquipmentManager* Owner = nullptr;
+
+	FAGREquipmentList()
+	{
+		SetDeltaSerializationEnabled(true);
+	}
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FastArrayDeltaSerialize<FAGREquipmentSlotEntry, FAGREquipmentList>(Items, DeltaParms, *this);
+	}
+
+	/* Client side: called once after all slot callbacks of a received update */
+	void PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters);
+};
+
+template<>
+struct TStructOpsTypeTraits<FAGREquipmentList> : public TStructOpsTypeTraitsBase2<FAGREquipmentList>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
 };
@@ -0,0 +1,78 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Data/AGRTypes.h"
+#include "Engine/DataAsset.h"
+
+#include "DA_AGR_EquipmentSchema.generated.h"
+
+/**
+ * Slot acceptance rules compiled to bitmasks.
+ *
+ * For every tag that is, or is a child of, an acceptable tag of a slot, the bit of that slot is set. The mask of an
+ * item is a single lookup of its slot type, so checking a slot is a single AND instead of a MatchesAnyTags hierarchy walk.
+ * Only the first 64 slots fit into the mask, IsSlotAcceptable falls back to tag matching for the rest.
+ */
+struct AGRPRO_API FAGREquipmentAcceptance
+{
+	static constexpr int32 MaxMaskedSlots = 64;
+
+	void Build(const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions);
+	void Reset();
+
+	bool IsBuilt() const { return bBuilt; }
+
+	/* Slots accepting the item slot type, bit N = slot N */
+	uint64 GetItemMask(const FGameplayTag& ItemTag) const;
+
+	bool IsSlotAcceptable(
+		const TArray<FAGREquipmentSlotDefinition>& SlotDefinitions,
+		const int32 SlotIndex,
+		const uint64 ItemMask,
+		const FGameplayTag& ItemTag) const;
+
+private:
+	TMap<FGameplayTag, uint64> TagMasks;
+	bool bBuilt = false;
+};
+
+/**
+ * Equipment slot layout shared by all characters of a kind.
+ *
+ * The equipment manager only stores and replicates the item per slot index, slot ids and acceptable tags live here.
+ */
+UCLASS(BlueprintType, Blueprintable)
+class AGRPRO_API UDA_AGR_EquipmentSchema : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	/* Slot ids need to be unique. At most 256 slots. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "AGR|Setup")
+	TArray<FAGREquipmentSlotDefinition> Slots;
+
+private:
+	/* Slot id -> index in Slots, built on load and edit */
+	TMap<FName, int32> SlotIndexMap;
+
+	/* Built on first use, the tag table may not be complete when the asset loads */
+	mutable FAGREquipmentAcceptance Acceptance;
+
+public:
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	/* Returns INDEX_NONE if the slot does not exist */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "AGR")
+	int32 FindSlotIndex(const FName Slot) const;
+
+	/* Call after changing Slots at runtime */
+	UFUNCTION(BlueprintCallable, Category = "AGR")
+	void BuildLookup();
+
+	const FAGREquipmentAcceptance& GetAcceptance() const;
+};
@@ -0,0 +1,121 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "CollisionQueryParams.h"
+#include "Engine/World.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "AGR_AnimMasterSubsystem.generated.h"
+
+class UAGRAnimMasterComponent;
+
+/* Aim trace of one AnimMaster component, queued for the next batch */
+struct FAGRAimTraceRequest
+{
+	TWeakObjectPtr<UAGRAnimMasterComponent> Component;
+	FVector Start = FVector::ZeroVector;
+	FVector End = FVector::ZeroVector;
+	ECollisionChannel TraceChannel = ECC_Visibility;
+	FCollisionQueryParams QueryParams;
+	bool bUpdateAimOffset = false;
+
+	/* Filled by the batch */
+	FHitResult HitResult;
+	bool bHit = false;
+};
+
+/* Per component state of managed AnimMaster ticks, one array per field and one element per component */
+struct FAGRManagedAnimMasterData
+{
+	TArray<float> TimeUntilTick;
+	TArray<bool> bTickEnabled;
+
+	/* Turn in place inputs, gathered for the components ticking this frame */
+	TArray<bool> bTurnInPlace;
+	TArray<float> AimYaw;
+	TArray<float> ActorYaw;
+	TArray<float> Speed;
+	TArray<float> TurnStartAngle;
+	TArray<float> TurnStopTolerance;
+
+	/* Turn in place output: 1 = start turning, 0 = stop turning, -1 = keep */
+	TArray<int8> TurnDecision;
+
+	void Add();
+	void RemoveAtSwap(const int32 Index);
+};
+
+/**
+ * World level services of AnimMaster (and SoundMaster) components.
+ *
+ * Runs the aim traces of AnimMaster components in Batched trace mode. Components queue their trace during their
+ * tick. All queued traces run together at the end of the frame, spread over worker threads, and the results are
+ * written back on the game thread. Animation reads them on the next update, as it does with traces run from the
+ * component tick.
+ *
+ * Also registers characters with the significance manager (see UAGRAnimSettings). Their distance to the closest
+ * viewer selects a significance bucket, which sets the aim rate and features of their AGR components.
+ */
+UCLASS()
+class AGRPRO_API UAGR_AnimMasterSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+private:
+	TArray<FAGRAimTraceRequest> AimTraceRequests;
+
+	/* Characters registered with the significance manager, by number of AGR components registering them */
+	TMap<TObjectKey<AActor>, int32> SignificanceRefCounts;
+
+	TArray<FTransform> Viewpoints;
+
+	/* Components ticked by the subsystem, see UAGRAnimSettings::bManageAnimMasterTicks. Index matches ManagedData. */
+	UPROPERTY()
+	TArray<UAGRAnimMasterComponent*> ManagedAnimMasters;
+
+	FAGRManagedAnimMasterData ManagedData;
+
+public:
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	FORCEINLINE static UAGR_AnimMasterSubsystem* Get(const UObject* WorldContextObject)
+	{
+		const UWorld* World = IsValid(WorldContextObject) ? WorldContextObject->GetWorld() : nullptr;
+		return IsValid(World) ? World->GetSubsystem<UAGR_AnimMasterSubsystem>() : nullptr;
+	}
+
+	void RequestAimTrace(
+		UAGRAnimMasterComponent* Component,
+		const FVector& Start,
+		const FVector& End,
+		const ECollisionChannel TraceChannel,
+		const FCollisionQueryParams& QueryParams,
+		const bool bUpdateAimOffset);
+
+	int32 GetNumPendingAimTraces() const { return AimTraceRequests.Num(); }
+
+	/* Called by AGR components on BeginPlay / EndPlay. The character is registered once, however many components it has. */
+	void RegisterSignificance(AActor* Actor);
+	void UnregisterSignificance(AActor* Actor);
+
+	/* Takes over the tick of the component. Called by the component when managed ticks are enabled. */
+	void RegisterManagedTick(UAGRAnimMasterComponent* Component);
+	void UnregisterManagedTick(UAGRAnimMasterComponent* Component);
+
+	/**
+	 * Tick enabled state of a managed component, set through its SetComponentTickEnabled (and so Activate / Deactivate).
+	 * The interval is read from the component's own tick function, so SetComponentTickInterval keeps working.
+	 */
+	void SetManagedTickState(const UAGRAnimMasterComponent* Component, const bool bEnabled);
+
+private:
+	void RunAimTraces();
+
+	void UpdateSignificanceManager();
+
+	void TickManagedAnimMasters(const float DeltaTime);
+};
@@ -0,0 +1,130 @@
+// Copyright Adam Grodzki All Rights Reserved.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Engine/World.h"
+#include "Subsystems/WorldSubsystem.h"
+
+#include "AGR_ItemSubsystem.generated.h"
+
+class UAGR_ItemComponent;
+
+/* One item lying in the world, as seen by the dropped item grid */
+struct FAGRDroppedItemEntry
+{
+	TWeakObjectPtr<UAGR_ItemComponent> ItemComponent;
+	FVector Location = FVector::ZeroVector;
+	FIntPoint Cell = FIntPoint::ZeroValue;
+
+	/* World time of the drop, used for settling and age based despawn */
+	float DropTime = 0.0f;
+	bool bSettled = false;
+
+	/* Went through DropItem. Only dropped items are merged, settled and despawned, placed items are just indexed. */
+	bool bDropped = false;
+};
+
+/**
+ * Keeps track of AGR items lying in the world.
+ *
+ * Dropped items are stored in a uniform 2D grid so proximity queries (pickup prompts, auto-loot, ...) never have to
+ * touch the physics scene. Items are added on drop, removed on pick up / destroy and re-indexed when their physics
+ * body goes to sleep. Only the server indexes items as dropping and picking up is authority only.
+ *
+ * On top of the index the subsystem manages the lifecycle of dropped items within a per-frame budget: identical
+ * stackables lying close together are merged, settled physics bodies are put to sleep and items are despawned by
+ * age and per-cell count caps (lowest DespawnPriority first). Items placed in the level are indexed for queries but
+ * never merged, capped or despawned.
+ */
+UCLASS()
+class AGRPRO_API UAGR_ItemSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+private:
+	TArray<FAGRDroppedItemEntry> DroppedItems;
+
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	float CellSize = 500.0f;
+
+	/* Next entry the lifecycle pass looks at. Wraps around so every item is visited over time. */
+	int32 ProcessCursor = 0;
+
+	/* Items despawned by the current lifecycle pass. Destroying is deferred so the entry array is stable while iterating. */
+	TArray<UAGR_ItemComponent*> PendingDespawn;
+
+	/* Same items as PendingDespawn, for constant time lookups while the pass runs */
+	TSet<const UAGR_ItemComponent*> PendingDespawnSet;
+
+	/* All items of the world by ItemId, on server and clients. Dropped or not. */
+	TMap<FGuid, TWeakObjectPtr<UAGR_ItemComponent>> ItemsById;
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	FORCEINLINE static UAGR_ItemSubsystem* Get(const UObject* WorldContextObject)
+	{
+		const UWorld* World = IsValid(WorldContextObject) ? WorldContextObject->GetWorld() : nullptr;
+		return IsValid(World) ? World->GetSubsystem<UAGR_ItemSubsystem>() : nullptr;
+	}
+
+	/* Adds the item to the grid, or refreshes its location if it is already indexed. bDropped enables lifecycle management. */
+	void RegisterDroppedItem(UAGR_ItemComponent* ItemComponent, const bool bDropped = false);
+
+	void UnregisterDroppedItem(UAGR_ItemComponent* ItemComponent);
+
+	/* Call after moving a dropped item by hand (e.g. placing it in front of the player after DropItem) */
+	UFUNCTION(BlueprintCallable, Category="AGR")
+	void RefreshDroppedItem(AActor* Item);
+
+	/* Finds all dropped items whose location is inside the sphere. Server only, always empty on clients. */
+	UFUNCTION(BlueprintCallable, Category="AGR")
+	UPARAM(DisplayName = "Found") bool QueryItemsInRadius(
+		const FVector Origin,
+		const float Radius,
+		UPARAM(DisplayName = "Items") TArray<AActor*>& OutItems) const;
+
+	/* Finds all dropped items inside the cone. HalfAngle is in degrees, Direction does not need to be normalized.
+	 * Server only, always empty on clients. */
+	UFUNCTION(BlueprintCallable, Category="AGR")
+	UPARAM(DisplayName = "Found") bool QueryItemsInCone(
+		const FVector Origin,
+		const FVector Direction,
+		const float Range,
+		const float HalfAngle,
+		UPARAM(DisplayName = "Items") TArray<AActor*>& OutItems) const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category="AGR")
+	int32 GetNumDroppedItems() const { return DroppedItems.Num(); }
+
+	/* Item id registry, kept up to date by the item components */
+	void RegisterItemId(UAGR_ItemComponent* ItemComponent, const FGuid& ItemId);
+	void UnregisterItemId(const UAGR_ItemComponent* ItemComponent, const FGuid& ItemId);
+
+	UAGR_ItemComponent* FindItemComponentById(const FGuid& ItemId) const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category="AGR")
+	UPARAM(DisplayName = "Found") bool FindItemById(const FGuid& ItemId, UPARAM(DisplayName = "Item") AActor*& OutItem) const;
+
+private:
+	FIntPoint GetCell(const FVector& Location) const;
+
+	void AddToCell(const FIntPoint& Cell, const int32 EntryIndex);
+	void RemoveFromCell(const FIntPoint& Cell, const int32 EntryIndex);
+
+	void ProcessEntry(const int32 EntryIndex, const float WorldTime);
+	void SettleEntry(FAGRDroppedItemEntry& Entry, UPrimitiveComponent* PrimitiveComponent, const float WorldTime);
+	void MergeStacks(const FAGRDroppedItemEntry& Entry);
+	void EnforceCellCap(const FIntPoint& Cell);
+	void Despawn(UAGR_ItemComponent* ItemComponent);
+	bool IsPendingDespawn(const UAGR_ItemComponent* ItemComponent) const;
+
+	/* Calls Visitor for every live entry whose cell overlaps the XY bounds of the sphere */
+	template<typename VisitorType>
+	void ForEachEntryNear(const FVector& Origin, const float Radius, VisitorType&& Visitor) const;
+};